@@ -26,15 +26,6 @@ static u32 const ar4x_mode[4] =
     STATUS_LED_ON|CRT_PORT_ULTIMAX
 };
 
-/*************************************************
-* C64 bus read callback (VIC-II cycle)
-*************************************************/
-FORCE_INLINE bool ar4x_vic_read_handler(u32 control, u32 addr)
-{
-    // Not needed
-    return false;
-}
-
 /*************************************************
 * C64 bus read callback (CPU cycle)
 *************************************************/
@@ -160,4 +151,4 @@ static void ar4x_init(void)
 }
 
 // VIC-II read support is not needed, but it is less timing critical
-C64_VIC_BUS_HANDLER_EX(ar4x)
+C64_VIC_BUS_HANDLER_EX_SHARED(ar4x, crt_no_vic_read_handler, ar4x_write_handler)
@@ -32,13 +32,5 @@ FORCE_INLINE bool c128_read_handler(u32 control, u32 addr)
     return false;
 }
 
-/*************************************************
-* C64 bus write callback
-*************************************************/
-FORCE_INLINE void c128_write_handler(u32 control, u32 addr, u32 data)
-{
-    // No write support
-}
-
 // Support C128 2MHz read access
-C64_C128_BUS_HANDLER(c128)
+C64_C128_BUS_HANDLER_WRITE(c128, crt_write_handler)
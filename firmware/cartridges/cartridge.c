@@ -243,6 +243,7 @@ static void crt_install_handler(DAT_CRT_HEADER *crt_header)
     u32 cartridge_type = crt_header->type;
     bool vic_support = (crt_header->flags & CRT_FLAG_VIC) != 0;
     void (*handler)(void) = crt_get_handler(cartridge_type, vic_support);
+    c64_bus_stats_start(cartridge_type);
     C64_INSTALL_HANDLER(handler);
 }
 
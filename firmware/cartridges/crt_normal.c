@@ -41,6 +41,14 @@ FORCE_INLINE bool crt_vic_read_handler(u32 control, u32 data)
     return false;
 }
 
+/*************************************************
+* C64 bus read callback (VIC-II cycle, not needed)
+*************************************************/
+FORCE_INLINE bool crt_no_vic_read_handler(u32 control, u32 addr)
+{
+    return false;
+}
+
 /*************************************************
 * C64 bus read callback
 *************************************************/
@@ -55,6 +63,20 @@ FORCE_INLINE bool crt_read_handler(u32 control, u32 addr)
     return false;
 }
 
+/*************************************************
+* C64 bus read callback (8k ROML only)
+*************************************************/
+FORCE_INLINE bool crt_roml_read_handler(u32 control, u32 addr)
+{
+    if (!(control & C64_ROML))
+    {
+        C64_DATA_WRITE(crt_ptr[addr & 0x1fff]);
+        return true;
+    }
+
+    return false;
+}
+
 /*************************************************
 * C64 bus write callback
 *************************************************/
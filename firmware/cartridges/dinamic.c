@@ -38,12 +38,4 @@ FORCE_INLINE bool dinamic_read_handler(u32 control, u32 addr)
     return false;
 }
 
-/*************************************************
-* C64 bus write callback
-*************************************************/
-FORCE_INLINE void dinamic_write_handler(u32 control, u32 addr, u32 data)
-{
-    // No write support
-}
-
-C64_BUS_HANDLER(dinamic)
+C64_BUS_HANDLER_WRITE(dinamic, crt_write_handler)
@@ -31,29 +31,6 @@ static u32 const ef_mode[8] =
     STATUS_LED_ON|CRT_PORT_8K
 };
 
-/*************************************************
-* C64 bus read callback (early VIC-II cycle)
-*************************************************/
-FORCE_INLINE u32 ef_early_vic_handler(u32 addr)
-{
-    // Speculative read
-    return crt_ptr[addr & 0x3fff];
-}
-
-/*************************************************
-* C64 bus read callback (VIC-II cycle)
-*************************************************/
-FORCE_INLINE bool ef_vic_read_handler(u32 control, u32 data)
-{
-    if ((control & (C64_ROML|C64_ROMH)) != (C64_ROML|C64_ROMH))
-    {
-        C64_DATA_WRITE(data);
-        return true;
-    }
-
-    return false;
-}
-
 /*************************************************
 * C64 bus read callback
 *************************************************/
@@ -128,4 +105,4 @@ static void ef_init(void)
 }
 
 // Needed for VIC-II and C128 read accesses at 2 MHz (e.g. for Prince of Persia)
-C64_VIC_BUS_HANDLER(ef)
+C64_VIC_BUS_HANDLER_SHARED(ef, crt)
@@ -52,17 +52,9 @@ FORCE_INLINE bool epyx_read_handler(u32 control, u32 addr)
     return false;
 }
 
-/*************************************************
-* C64 bus write callback
-*************************************************/
-FORCE_INLINE void epyx_write_handler(u32 control, u32 addr, u32 data)
-{
-    // No write support
-}
-
 static void epyx_init(void)
 {
     C64_CRT_CONTROL(STATUS_LED_ON|CRT_PORT_8K);
 }
 
-C64_BUS_HANDLER(epyx)
+C64_BUS_HANDLER_WRITE(epyx, crt_write_handler)
@@ -22,15 +22,6 @@
 #define RESET_TOOGLE *MEMU_SIGNATURE_BUF
 static u32 io1_state;
 
-/*************************************************
-* C64 bus read callback (VIC-II cycle)
-*************************************************/
-FORCE_INLINE bool fm_vic_read_handler(u32 control, u32 addr)
-{
-    // Not needed
-    return false;
-}
-
 /*************************************************
 * C64 bus read callback (CPU cycle)
 *************************************************/
@@ -84,14 +75,6 @@ FORCE_INLINE void fm_early_write_handler(void)
     }
 }
 
-/*************************************************
-* C64 bus write callback
-*************************************************/
-FORCE_INLINE void fm_write_handler(u32 control, u32 addr, u32 data)
-{
-    // Not needed
-}
-
 static void fm_init(DAT_CRT_HEADER *crt_header)
 {
     C64_CRT_CONTROL(STATUS_LED_ON|CRT_PORT_8K);
@@ -122,4 +105,4 @@ static void fm_init(DAT_CRT_HEADER *crt_header)
 }
 
 // VIC-II read support is not needed, but it is less timing critical
-C64_VIC_BUS_HANDLER_EX(fm)
+C64_VIC_BUS_HANDLER_EX_SHARED(fm, crt_no_vic_read_handler, crt_write_handler)
@@ -18,20 +18,6 @@
  * 3. This notice may not be removed or altered from any source distribution.
  */
 
-/*************************************************
-* C64 bus read callback
-*************************************************/
-FORCE_INLINE bool magic_desk_read_handler(u32 control, u32 addr)
-{
-    if (!(control & C64_ROML))
-    {
-        C64_DATA_WRITE(crt_ptr[addr & 0x1fff]);
-        return true;
-    }
-
-    return false;
-}
-
 /*************************************************
 * C64 bus write callback
 *************************************************/
@@ -64,4 +50,4 @@ static void magic_desk_init(void)
     C64_CRT_CONTROL(STATUS_LED_ON|CRT_PORT_8K);
 }
 
-C64_BUS_HANDLER(magic_desk)
+C64_BUS_HANDLER_READ(magic_desk, crt_roml_read_handler)
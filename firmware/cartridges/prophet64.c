@@ -18,20 +18,6 @@
  * 3. This notice may not be removed or altered from any source distribution.
  */
 
-/*************************************************
-* C64 bus read callback
-*************************************************/
-FORCE_INLINE bool prophet64_read_handler(u32 control, u32 addr)
-{
-    if (!(control & C64_ROML))
-    {
-        C64_DATA_WRITE(crt_ptr[addr & 0x1fff]);
-        return true;
-    }
-
-    return false;
-}
-
 /*************************************************
 * C64 bus write callback
 *************************************************/
@@ -54,4 +40,4 @@ FORCE_INLINE void prophet64_write_handler(u32 control, u32 addr, u32 data)
     }
 }
 
-C64_BUS_HANDLER(prophet64)
+C64_BUS_HANDLER_READ(prophet64, crt_roml_read_handler)
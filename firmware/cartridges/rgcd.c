@@ -20,20 +20,6 @@
 
 static u8 rgcd_bank_xor;
 
-/*************************************************
-* C64 bus read callback
-*************************************************/
-FORCE_INLINE bool rgcd_read_handler(u32 control, u32 addr)
-{
-    if (!(control & C64_ROML))
-    {
-        C64_DATA_WRITE(crt_ptr[addr & 0x1fff]);
-        return true;
-    }
-
-    return false;
-}
-
 /*************************************************
 * C64 bus write callback
 *************************************************/
@@ -66,4 +52,4 @@ static void rgcd_init(DAT_CRT_HEADER *crt_header)
     C64_CRT_CONTROL(STATUS_LED_ON|CRT_PORT_8K);
 }
 
-C64_BUS_HANDLER(rgcd)
+C64_BUS_HANDLER_READ(rgcd, crt_roml_read_handler)
@@ -31,15 +31,6 @@ static u32 const ss5_mode[8] =
     STATUS_LED_OFF|CRT_PORT_8K
 };
 
-/*************************************************
-* C64 bus read callback (VIC-II cycle)
-*************************************************/
-FORCE_INLINE bool ss5_vic_read_handler(u32 control, u32 addr)
-{
-    // Not needed
-    return false;
-}
-
 /*************************************************
 * C64 bus read callback (CPU cycle)
 *************************************************/
@@ -155,4 +146,4 @@ static void ss5_init(void)
 }
 
 // VIC-II read support is not needed, but it is less timing critical
-C64_VIC_BUS_HANDLER_EX(ss5)
+C64_VIC_BUS_HANDLER_EX_SHARED(ss5, crt_no_vic_read_handler, ss5_write_handler)
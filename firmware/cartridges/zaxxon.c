@@ -43,18 +43,10 @@ FORCE_INLINE bool zaxxon_read_handler(u32 control, u32 addr)
     return false;
 }
 
-/*************************************************
-* C64 bus write callback
-*************************************************/
-FORCE_INLINE void zaxxon_write_handler(u32 control, u32 addr, u32 data)
-{
-    // No write support
-}
-
 static void zaxxon_init(void)
 {
     C64_CRT_CONTROL(STATUS_LED_ON|CRT_PORT_16K);
     crt_rom_ptr = crt_banks[0];
 }
 
-C64_BUS_HANDLER(zaxxon)
+C64_BUS_HANDLER_WRITE(zaxxon, crt_write_handler)
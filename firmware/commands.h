@@ -97,7 +97,9 @@ typedef enum
 
     REPLY_LISTEN,
     REPLY_UNLISTEN,
-    REPLY_RECEIVE_BYTE
+    REPLY_RECEIVE_BYTE,
+
+    REPLY_LOAD_NEXT
 } COMMAND_TYPE;
 
 typedef enum
@@ -107,6 +109,7 @@ typedef enum
     CMD_EAPI_INIT,
     CMD_WRITE_FLASH,
     CMD_ERASE_SECTOR,
+    CMD_WRITE_FLASH_BLOCK
 } EAPI_COMMAND_TYPE;
 
 typedef enum
@@ -25,6 +25,7 @@
 
 #define ARRAY_COUNT(array) (sizeof(array) / sizeof(*(array)))
 
+typedef uint64_t u64;
 typedef uint32_t u32;
 typedef int32_t s32;
 typedef uint16_t u16;
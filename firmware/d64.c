@@ -24,15 +24,7 @@
  * (C)2003/2009 by iAN CooG/HokutoForce^TWT^HVSC
  */
 
-static inline bool d64_sync(D64_IMAGE *image)
-{
-    return file_sync(&image->file);
-}
-
-static inline bool d64_close(D64_IMAGE *image)
-{
-    return file_close(&image->file);
-}
+static D64_CACHE d64_cache;
 
 static FSIZE_t d64_get_offset(D64_IMAGE *image, D64_TS ts)
 {
@@ -89,8 +81,198 @@ static bool d64_seek(D64_IMAGE *image, D64_TS ts)
     return true;
 }
 
+static u8 d64_track_sectors(D64_IMAGE *image, u8 track)
+{
+    if (image->type == D64_TYPE_D81)
+    {
+        return D81_SECTORS;
+    }
+
+    if (image->type == D64_TYPE_D71 && track > D64_TRACKS)
+    {
+        track -= D64_TRACKS;
+    }
+
+    if (track >= ARRAY_COUNT(d64_track_offset))
+    {
+        return 17;  // Track 42
+    }
+
+    return d64_track_offset[track] - d64_track_offset[track-1];
+}
+
+static bool d64_cache_write_track(D64_IMAGE *image, D64_CACHE_TRACK *entry)
+{
+    if (!entry->dirty)
+    {
+        return true;
+    }
+
+    // Write from first to last dirty sector
+    u8 first = __builtin_ctzll(entry->dirty);
+    u8 last = 63 - __builtin_clzll(entry->dirty);
+    D64_TS ts = {entry->track, first};
+    u32 len = (last - first + 1) * D64_SECTOR_LEN;
+
+    if (!d64_seek(image, ts) ||
+        file_write(&image->file, entry->data + first * D64_SECTOR_LEN,
+                   len) != len)
+    {
+        return false;
+    }
+
+    entry->dirty = 0;
+    return true;
+}
+
+static bool d64_cache_write_back(D64_IMAGE *image)
+{
+    bool res = true;
+    if (d64_cache.image == image)
+    {
+        for (u32 i=0; i<d64_cache.tracks; i++)
+        {
+            res &= d64_cache_write_track(image, d64_cache.track + i);
+        }
+    }
+
+    return res;
+}
+
+static bool d64_cache_detach(D64_IMAGE *image)
+{
+    bool res = true;
+    if (d64_cache.image && d64_cache.image == image)
+    {
+        res = d64_cache_write_back(image);
+        if (!res)
+        {
+            err("Failed to write back track cache");
+        }
+
+        dbg("Track cache hits: %u misses: %u", d64_cache.hits,
+            d64_cache.misses);
+        d64_cache.image = NULL;
+    }
+
+    return res;
+}
+
+static void d64_cache_attach(D64_IMAGE *image)
+{
+    d64_cache_detach(d64_cache.image);
+
+    u32 track_size = (image->type == D64_TYPE_D81 ?
+                      D81_SECTORS : D64_MAX_SECTORS) * D64_SECTOR_LEN;
+    u32 tracks = d64_cache.size / track_size;
+    if (tracks > D64_CACHE_TRACKS)
+    {
+        tracks = D64_CACHE_TRACKS;
+    }
+
+    for (u32 i=0; i<tracks; i++)
+    {
+        D64_CACHE_TRACK *entry = d64_cache.track + i;
+        entry->track = 0;
+        entry->used = 0;
+        entry->dirty = 0;
+        entry->data = d64_cache.buf + i * track_size;
+    }
+
+    d64_cache.image = image;
+    d64_cache.tracks = tracks;
+    d64_cache.hits = 0;
+    d64_cache.misses = 0;
+}
+
+// Tracks are cached in buf (if any) with LRU eviction and write-back
+static void d64_set_track_cache(u8 *buf, u32 size)
+{
+    d64_cache_detach(d64_cache.image);
+    d64_cache.buf = buf;
+    d64_cache.size = buf ? size : 0;
+}
+
+static D64_CACHE_TRACK * d64_cache_get(D64_IMAGE *image, D64_TS ts)
+{
+    if (!d64_cache.buf || !ts.track)
+    {
+        return NULL;
+    }
+
+    if (d64_cache.image != image)
+    {
+        d64_cache_attach(image);
+    }
+
+    u8 sectors = d64_track_sectors(image, ts.track);
+    if (ts.sector >= sectors)
+    {
+        return NULL;
+    }
+
+    D64_CACHE_TRACK *entry = NULL;
+    for (u32 i=0; i<d64_cache.tracks; i++)
+    {
+        D64_CACHE_TRACK *track = d64_cache.track + i;
+        if (track->track == ts.track)
+        {
+            d64_cache.hits++;
+            track->used = ++d64_cache.time;
+            return track;
+        }
+
+        if (!entry || track->used < entry->used)
+        {
+            entry = track;
+        }
+    }
+
+    // Replace least recently used track
+    if (!entry || !d64_cache_write_track(image, entry))
+    {
+        return NULL;
+    }
+
+    d64_cache.misses++;
+    entry->track = 0;
+
+    D64_TS start = {ts.track, 0};
+    u32 len = sectors * D64_SECTOR_LEN;
+    if (!d64_seek(image, start) ||
+        file_read(&image->file, entry->data, len) != len)
+    {
+        return NULL;
+    }
+
+    entry->track = ts.track;
+    entry->sectors = sectors;
+    entry->used = ++d64_cache.time;
+    return entry;
+}
+
+static bool d64_sync(D64_IMAGE *image)
+{
+    bool res = d64_cache_write_back(image);
+    return file_sync(&image->file) && res;
+}
+
+static bool d64_close(D64_IMAGE *image)
+{
+    bool res = d64_cache_detach(image);
+    return file_close(&image->file) && res;
+}
+
 static bool d64_seek_read(D64_IMAGE *image, void *buffer, D64_TS ts)
 {
+    D64_CACHE_TRACK *track = d64_cache_get(image, ts);
+    if (track)
+    {
+        memcpy(buffer, track->data + ts.sector * D64_SECTOR_LEN,
+               D64_SECTOR_LEN);
+        return true;
+    }
+
     return d64_seek(image, ts) &&
            file_read(&image->file, buffer, D64_SECTOR_LEN) == D64_SECTOR_LEN;
 }
@@ -121,6 +303,21 @@ static inline bool d64_read_next(D64 *d64)
 
 static bool d64_seek_write(D64_IMAGE *image, void *buffer, D64_TS ts)
 {
+    // Written to disk on sync or when the track is evicted
+    D64_CACHE_TRACK *track = NULL;
+    if (image->file.flag & FA_WRITE)
+    {
+        track = d64_cache_get(image, ts);
+    }
+
+    if (track)
+    {
+        memcpy(track->data + ts.sector * D64_SECTOR_LEN, buffer,
+               D64_SECTOR_LEN);
+        track->dirty |= (u64)1 << ts.sector;
+        return true;
+    }
+
     return d64_seek(image, ts) &&
            file_write(&image->file, buffer, D64_SECTOR_LEN) == D64_SECTOR_LEN;
 }
@@ -658,22 +855,9 @@ static bool d64_find_available_track(D64 *d64, u8 *track)
     return false;   // disk is full
 }
 
-static u8 d64_get_sectors(D64 *d64, u8 track)
+static inline u8 d64_get_sectors(D64 *d64, u8 track)
 {
-    switch (d64->image->type)
-    {
-        case D64_TYPE_D81:
-            return D81_SECTORS;
-
-        case D64_TYPE_D71:
-            if (track > D64_TRACKS)
-            {
-                track -= D64_TRACKS;
-            }
-            // fall through
-        default:
-            return d64_track_offset[track] - d64_track_offset[track-1];
-    }
+    return d64_track_sectors(d64->image, track);
 }
 
 static bool d64_find_free_sector(D64 *d64, D64_TS *ts, u8 interleave)
@@ -905,7 +1089,7 @@ static size_t d64_write_data(D64 *d64, u8 *buf, size_t buf_size)
         written_bytes += bytes_to_copy;
     }
 
-    d64_sync(d64->image);
+    // Data is synced by d64_write_finalize()
     return written_bytes;
 }
 
@@ -961,6 +1145,7 @@ static void d64_init(D64_IMAGE *image, D64 *d64)
 
 static bool d64_open(D64_IMAGE *image, const char *filename)
 {
+    d64_cache_detach(image);
     if (!file_open(&image->file, filename, FA_READ|FA_WRITE) &&
         !file_open(&image->file, filename, FA_READ))
     {
@@ -974,5 +1159,7 @@ static bool d64_open(D64_IMAGE *image, const char *filename)
         return false;
     }
 
+    // The image size is fixed so random access can use fast seek
+    file_fast_seek(&image->file, image->clmt);
     return d64_read_header(image);
 }
@@ -30,6 +30,7 @@
 #define D71_TRACKS          70
 #define D81_TRACKS          80
 #define D81_SECTORS         40
+#define D64_MAX_SECTORS     21
 
 #define D64_TRACK_DIR       18
 #define D64_SECTOR_HEADER   0
@@ -196,6 +197,7 @@ typedef struct
 typedef struct
 {
     FIL file;
+    DWORD clmt[FILE_CLMT_SIZE]; // Cluster link map table for fast seek
     u8 type;            // D64_TYPE
 
     union               // Cached header/BAM sectors
@@ -217,6 +219,32 @@ typedef struct
     };
 } D64_IMAGE;
 
+#define D64_CACHE_TRACKS    4
+
+typedef struct
+{
+    u8 track;           // 0 = unused
+    u8 sectors;
+    u32 used;           // For LRU eviction
+    u64 dirty;          // Bit per sector
+    u8 *data;
+} D64_CACHE_TRACK;
+
+typedef struct
+{
+    u8 *buf;
+    u32 size;
+
+    D64_IMAGE *image;   // Image currently cached
+    u8 tracks;          // Number of tracks that fits in buf
+    u32 time;
+
+    u32 hits;
+    u32 misses;
+
+    D64_CACHE_TRACK track[D64_CACHE_TRACKS];
+} D64_CACHE;
+
 typedef struct
 {
     D64_TS start;
@@ -48,6 +48,75 @@ static void usb_send_text(const char *text)
     }
 }
 
+#if BUS_STATS
+static const char *diag_bus_paths[BUS_STATS_PATHS] = {"Read", "Write", "VIC"};
+
+// Fail if a bus handler path finished after its deadline
+static inline bool diag_bus_stats_passed(BUS_PATH_STATS *stats)
+{
+    return !stats->misses;
+}
+
+static void diag_send_bus_stats_usb(void)
+{
+    if (!c64_bus_stats_valid())
+    {
+        usb_send_text("No bus statistics\r\n");
+        return;
+    }
+
+    sprint(scratch_buf, "Bus handler of CRT type %u (%s)\r\n",
+           bus_stats.cartridge_type, bus_stats.ntsc ? "NTSC" : "PAL");
+    usb_send_text(scratch_buf);
+
+    for (u32 i = 0; i < BUS_STATS_PATHS; i++)
+    {
+        BUS_PATH_STATS *stats = &bus_stats.path[i];
+        if (!stats->max)
+        {
+            continue;
+        }
+
+        sprint(scratch_buf, "%5s %s max %u/%u p50 %u p99 %u p999 %u misses %u\r\n",
+               diag_bus_paths[i], diag_bus_stats_passed(stats) ? "PASS" : "FAIL",
+               stats->max, stats->deadline,
+               c64_bus_stats_percentile(stats, 500),
+               c64_bus_stats_percentile(stats, 990),
+               c64_bus_stats_percentile(stats, 999), stats->misses);
+        usb_send_text(scratch_buf);
+
+        for (u32 j = 0; j < BUS_STATS_BUCKETS; j++)
+        {
+            if (stats->histogram[j])
+            {
+                sprint(scratch_buf, "  %3u: %u\r\n", j * BUS_STATS_BUCKET_SIZE,
+                       stats->histogram[j]);
+                usb_send_text(scratch_buf);
+            }
+        }
+    }
+}
+
+static void diag_send_bus_stats_c64(void)
+{
+    if (!c64_bus_stats_valid())
+    {
+        return;
+    }
+
+    for (u32 i = 0; i < BUS_STATS_PATHS; i++)
+    {
+        BUS_PATH_STATS *stats = &bus_stats.path[i];
+        bool passed = diag_bus_stats_passed(stats);
+        sprint(scratch_buf, "%5s %s max %3u/%3u p99 %3u", diag_bus_paths[i],
+               passed ? "PASS" : "FAIL", stats->max, stats->deadline,
+               c64_bus_stats_percentile(stats, 990));
+        c64_send_text(passed ? COLOR_LIGHTGREEN : COLOR_LIGHTRED,
+                      0, 12 + i, scratch_buf);
+    }
+}
+#endif
+
 static bool diag_timeout_handler(void)
 {
     if (!diag_wait_timeout)
@@ -86,6 +155,9 @@ static bool diag_send_result(bool saving)
             diag_header);
         c64_send_message(scratch_buf);
         c64_send_text(COLOR_PURPLE, 0, 4, diag_underline);
+#if BUS_STATS
+        diag_send_bus_stats_c64();
+#endif
     }
     else
     {
@@ -142,6 +214,109 @@ NO_RETURN diag_save_and_restart(s8 offset)
     system_restart();
 }
 
+// Test rounds for each phi2 offset during calibration
+#define DIAG_CALIBRATE_ROUNDS   32
+
+// Wait for the C64 to reply to the command. Fails on timeout or if the
+// reply is not the expected one
+static bool diag_calibrate_command(u8 cmd, u32 timeout_ms)
+{
+    c64_set_command(cmd);
+
+    u8 reply;
+    for (u32 i = 0; i < timeout_ms; i++)
+    {
+        timer_start_ms(1);
+        while (!timer_elapsed())
+        {
+            if (c64_get_reply(cmd, &reply))
+            {
+                return reply == REPLY_OK;
+            }
+        }
+    }
+
+    c64_set_command(CMD_NONE);
+    return false;
+}
+
+// Start the launcher with the phi2 offset and count the failed rounds.
+// Each round transfers text to the C64 and lets it run the KFF RAM test in
+// kff_wait_for_sync which exercises the ROM, I/O and RAM read/write paths
+static u32 diag_calibrate_offset(s8 offset)
+{
+    c64_interface(false);
+    c64_reset(true);
+
+    dat_file.phi2_offset = offset;
+    C64_INSTALL_HANDLER(kff_handler);
+    kff_init();
+    c64_interface_enable_no_check();
+    c64_reset(false);
+
+    u32 errors = 0;
+    u32 timeout = 2000; // Allow the launcher to start
+    for (u32 i = 0; i < DIAG_CALIBRATE_ROUNDS; i++)
+    {
+        sprint(scratch_buf, "Calibrating phi2 offset %d   ", offset);
+        c64_send_cxy_text(COLOR_YELLOW, 0, 0, scratch_buf);
+
+        if (!diag_calibrate_command(CMD_TEXT_WAIT, timeout) ||
+            !diag_calibrate_command(CMD_SYNC, 10))
+        {
+            errors++;
+        }
+        timeout = 10;
+    }
+
+    return errors;
+}
+
+// Sweep the phi2 offset and save the centre of the widest passing window
+static void diag_calibrate(void)
+{
+    s8 phi2_offset = dat_file.phi2_offset;
+    s8 start = 0, best_start = 0;
+    u32 length = 0, best_length = 0;
+
+    usb_send_text("Calibrating phi2 offset\r\n");
+    for (s8 offset = -PHI2_OFFSET_MAX; offset <= PHI2_OFFSET_MAX; offset++)
+    {
+        u32 errors = diag_calibrate_offset(offset);
+        sprint(scratch_buf, "%d: %u/%u errors\r\n", offset, errors,
+               DIAG_CALIBRATE_ROUNDS);
+        usb_send_text(scratch_buf);
+
+        if (errors)
+        {
+            length = 0;
+            continue;
+        }
+
+        if (!length++)
+        {
+            start = offset;
+        }
+
+        if (length > best_length)
+        {
+            best_length = length;
+            best_start = start;
+        }
+    }
+
+    c64_interface(false);
+    c64_reset(true);
+
+    if (best_length)
+    {
+        diag_save_and_restart(best_start + (best_length - 1) / 2);
+    }
+
+    usb_send_text("Calibration failed\r\n");
+    dat_file.phi2_offset = phi2_offset;
+}
+
 static void diag_handle_button(void)
 {
     u32 i = 0;
@@ -179,6 +354,16 @@ static void diag_handle_button(void)
         {
             dat_file.phi2_offset = 0;
             c64_reset(true);    // Reset C64 after phi2 adjustment
+
+            // Menu button very long press will start the calibration
+            while (button == MENU_BTN && diag_button_pressed())
+            {
+                if (++i > 400)
+                {
+                    diag_calibrate();
+                    break;
+                }
+            }
         }
 
         if (button & SPECIAL_BTN)
@@ -197,6 +382,9 @@ static void diag_handle_button(void)
 static void diag_loop(void)
 {
     usb_send_text(diag_header);
+#if BUS_STATS
+    diag_send_bus_stats_usb();
+#endif
     c64_wait_handler = diag_timeout_handler;
 
     if (diag_button_pressed() & SPECIAL_BTN)
@@ -515,8 +515,10 @@ static u8 disk_handle_load_prg(DISK_CHANNEL *channel)
         return CMD_NOT_FOUND;
     }
 
+    // Send the first chunk with the load address. The rest of the file is
+    // read while the C64 copies the previous chunk
     u8 *ptr = KFF_BUF;
-    u16 prg_size = disk_read_data(channel, ptr + 2, 64*1024 - 2);
+    u16 prg_size = disk_read_data(channel, ptr + 2, KFF_LOAD_CHUNK_SIZE + 2);
     if (prg_size < 2)
     {
         return CMD_DISK_ERROR;
@@ -524,7 +526,14 @@ static u8 disk_handle_load_prg(DISK_CHANNEL *channel)
 
     *(u16 *)ptr = prg_size  - 2;
 
-    dbg("Sending PRG. Start $%x size %u", *(u16 *)(ptr + 2), prg_size);
+    dbg("Sending PRG. Start $%x", *(u16 *)(ptr + 2));
+
+    if (prg_size - 2 == KFF_LOAD_CHUNK_SIZE)
+    {
+        disk_load.channel = channel;
+        disk_load.left = 64*1024 - 2 - prg_size;
+        disk_load.next_ready = false;
+    }
 
     return CMD_NONE;
 }
@@ -609,29 +618,48 @@ static void disk_send_data(u8 *buf)
     }
 }
 
+static void disk_basin_release(void)
+{
+    if (basin_channel)
+    {
+        // Keep the data not read by the C64 for the next BASIN request
+        basin_channel->basin_ptr = basin_channel->basin_len - KFF_BASIN_COUNT;
+        KFF_BASIN_COUNT = 0;
+        basin_channel = NULL;
+    }
+}
+
+static void disk_basin_reset(DISK_CHANNEL *channel)
+{
+    if (basin_channel == channel)
+    {
+        KFF_BASIN_COUNT = 0;
+        basin_channel = NULL;
+    }
+
+    channel->basin_len = 0;
+    channel->basin_ptr = 0;
+    channel->basin_eof = false;
+}
+
 static void disk_close_channel(DISK_CHANNEL *channel)
 {
     if (channel->buf_mode == DISK_BUF_SAVE)
     {
-        c64_send_command(CMD_WAIT_SYNC);
-        c64_interface(false);
-        disk_receive_data(channel->buf2);   // Save temp data
-
+        // SD card writes use DMA, no need to disable the C64 interface
         if (channel->buf_ptr)
         {
             disk_write_data(channel, channel->buf, channel->buf_ptr);
         }
 
         disk_write_finalize(channel);
-
-        disk_send_data(channel->buf2);   // Send temp data back
-        c64_interface_sync();
     }
 
     channel->buf_mode = DISK_BUF_USE;
     channel->buf_ptr = 0;
     channel->buf_len = 0;
     channel->buf2_ptr = 0;
+    disk_basin_reset(channel);
     d64_init(channel->d64.image, &channel->d64);
 }
 
@@ -659,10 +687,65 @@ static u8 disk_handle_load(DISK_CHANNEL *channel)
         cmd = disk_handle_load_prg(channel);
     }
 
-    disk_close_channel(channel);
+    if (disk_load.channel != channel)
+    {
+        disk_close_channel(channel);
+    }
     return cmd;
 }
 
+static void disk_load_prefetch(void)
+{
+    if (!disk_load.channel || disk_load.next_ready)
+    {
+        return;
+    }
+
+    u32 size = KFF_LOAD_CHUNK_SIZE;
+    if (size > disk_load.left)
+    {
+        size = disk_load.left;
+    }
+
+    disk_load.next_size = disk_read_data(disk_load.channel,
+                                         KFF_LOAD_NEXT_BUF + 2, size);
+    disk_load.left -= disk_load.next_size;
+    disk_load.next_ready = true;
+}
+
+static void disk_load_end(void)
+{
+    if (disk_load.channel)
+    {
+        disk_close_channel(disk_load.channel);
+        disk_load.channel = NULL;
+    }
+}
+
+static u8 disk_handle_load_next(void)
+{
+    u8 *ptr = KFF_BUF;
+    if (!disk_load.channel)
+    {
+        *(u16 *)ptr = 0;
+        return CMD_NONE;
+    }
+
+    disk_load_prefetch();
+    memcpy(ptr + 2, KFF_LOAD_NEXT_BUF + 2, disk_load.next_size);
+    *(u16 *)ptr = disk_load.next_size;
+    disk_load.next_ready = false;
+
+    // The C64 will not ask for more after a partial chunk
+    if (disk_load.next_size != KFF_LOAD_CHUNK_SIZE)
+    {
+        dbg("Sent last PRG chunk");
+        disk_load_end();
+    }
+
+    return CMD_NONE;
+}
+
 static u8 disk_save_file(DISK_CHANNEL *channel, PARSED_FILENAME *parsed,
                          D64_DIR_ENTRY *existing)
 {
@@ -1073,6 +1156,7 @@ static u8 disk_hand_open_buffer(DISK_CHANNEL *channel)
 static u8 disk_handle_open(DISK_CHANNEL *channel)
 {
     char *filename = channel->filename;
+    disk_basin_reset(channel);
 
     if (channel->number == 15)      // Command channel
     {
@@ -1110,26 +1194,18 @@ static u8 disk_handle_close(DISK_CHANNEL *channel, DISK_CHANNEL *channels)
     return CMD_NONE;
 }
 
-static u8 disk_handle_send_byte(DISK_CHANNEL *channel)
+static u8 disk_read_byte(DISK_CHANNEL *channel, u8 *data)
 {
-    if (!channel)
-    {
-        return CMD_DISK_ERROR;
-    }
-
     if (channel->number == 15 && !disk_bytes_left(channel))
     {
         disk_handle_command(channel, "-");  // Write disk status to buffer
     }
 
-    u8 data;
-    if (!disk_read_data(channel, &data, 1))
+    if (!disk_read_data(channel, data, 1))
     {
         return CMD_DISK_ERROR;
     }
 
-    *KFF_BUF = data;    // Send the byte
-
     if (!disk_bytes_left(channel))
     {
         if (channel->buf_mode == DISK_BUF_DIR)
@@ -1157,6 +1233,71 @@ static u8 disk_handle_send_byte(DISK_CHANNEL *channel)
     return CMD_NONE;
 }
 
+static bool disk_fill_basin(DISK_CHANNEL *channel)
+{
+    u8 cmd = CMD_NONE;
+    u32 len = 0;
+
+    while (len < sizeof(channel->basin_buf) && cmd == CMD_NONE)
+    {
+        cmd = disk_read_byte(channel, channel->basin_buf + len);
+        if (cmd == CMD_DISK_ERROR)
+        {
+            break;
+        }
+
+        len++;
+    }
+
+    channel->basin_len = len;
+    channel->basin_ptr = 0;
+    channel->basin_eof = cmd == CMD_END_OF_FILE;
+    return len != 0;
+}
+
+static u8 disk_handle_send_byte(DISK_CHANNEL *channel)
+{
+    if (!channel)
+    {
+        return CMD_DISK_ERROR;
+    }
+
+    if (basin_channel != channel)
+    {
+        disk_basin_release();
+    }
+
+    if (channel->basin_ptr >= channel->basin_len && !disk_fill_basin(channel))
+    {
+        return CMD_DISK_ERROR;
+    }
+
+    // Send up to a page of data. The C64 will read it without further
+    // requests. End of file is sent as a separate request
+    u8 cmd = CMD_NONE;
+    u8 len = channel->basin_len - channel->basin_ptr;
+    if (channel->basin_eof)
+    {
+        if (len == 1)
+        {
+            cmd = CMD_END_OF_FILE;
+        }
+        else
+        {
+            len--;
+        }
+    }
+
+    memcpy(KFF_BASIN_BUF, channel->basin_buf + channel->basin_ptr, len);
+    channel->basin_ptr += len;
+
+    KFF_BASIN_COUNT = len;
+    KFF_BASIN_PTR = 0;
+    basin_channel = channel;
+
+    return cmd;
+}
+
 static u8 disk_handle_unlisten(DISK_CHANNEL *channel)
 {
     if (!channel || channel->number != 15 || !channel->buf2_ptr)
@@ -1164,6 +1305,9 @@ static u8 disk_handle_unlisten(DISK_CHANNEL *channel)
         return CMD_NONE;
     }
 
+    // Discard old disk status
+    disk_basin_reset(channel);
+
     // Null terminate "filename"
     if (channel->buf2[channel->buf2_ptr - 1] == (u8)'\r')
     {
@@ -1180,16 +1324,22 @@ static u8 disk_handle_unlisten(DISK_CHANNEL *channel)
 
 static u8 disk_handle_receive_byte(DISK_CHANNEL *channel)
 {
+    // Data written by BSOUT is sent a page at a time
+    u8 *data = KFF_BSOUT_BUF;
+    u32 len = KFF_BSOUT_COUNT;
+    KFF_BSOUT_COUNT = 0;
+
     if (!channel)
     {
         return CMD_DISK_ERROR;
     }
 
-    u8 data = c64_receive_byte();
-
     if (channel->number == 15)
     {
-        channel->buf2[channel->buf2_ptr++] = data;
+        while (len--)
+        {
+            channel->buf2[channel->buf2_ptr++] = *data++;
+        }
         return CMD_NONE;
     }
 
@@ -1199,21 +1349,27 @@ static u8 disk_handle_receive_byte(DISK_CHANNEL *channel)
         return CMD_DISK_ERROR;
     }
 
-    channel->buf[channel->buf_ptr++] = data;
-    if (channel->buf_ptr >= sizeof(channel->buf))   // Check if buffer is full
+    while (len)
     {
-        channel->buf_ptr = 0;
-
-        if (channel->buf_mode == DISK_BUF_SAVE)
+        u32 size = sizeof(channel->buf) - channel->buf_ptr;
+        if (size > len)
         {
-            c64_send_command(CMD_WAIT_SYNC);
-            c64_interface(false);
-            disk_receive_data(channel->buf2);   // Save temp data
+            size = len;
+        }
 
-            disk_write_data(channel, channel->buf, sizeof(channel->buf));
+        memcpy(channel->buf + channel->buf_ptr, data, size);
+        channel->buf_ptr += size;
+        data += size;
+        len -= size;
 
-            disk_send_data(channel->buf2);  // Send temp data back
-            c64_interface_sync();
+        if (channel->buf_ptr >= sizeof(channel->buf))   // Check if buffer is full
+        {
+            channel->buf_ptr = 0;
+
+            if (channel->buf_mode == DISK_BUF_SAVE)
+            {
+                disk_write_data(channel, channel->buf, sizeof(channel->buf));
+            }
         }
     }
 
@@ -1247,6 +1403,7 @@ static void disk_receive_filename(char *filename)
 static u8 disk_send_command(u8 cmd, DISK_CHANNEL*channels)
 {
     c64_set_command(cmd);
+    disk_load_prefetch();   // Read next chunk while the C64 copies this one
 
     u32 led_status = STATUS_LED_OFF;
     for (u32 i=0; i<15; i++)
@@ -1287,6 +1444,10 @@ static void disk_loop(void)
     DISK_CHANNEL*channels = (DISK_CHANNEL *)(crt_ram_buf + 0x100);
     DISK_CHANNEL *channel, *talk = NULL, *listen = NULL;
     memset(channels, 0, sizeof(DISK_CHANNEL) * 16);
+    sdio_set_bounce_buffer(SDIO_BOUNCE_BUF);
+
+    disk_set_read_ahead(DISK_READ_AHEAD_BUF, DISK_READ_AHEAD_SIZE);
+    d64_set_track_cache(DISK_TRACK_CACHE_BUF, DISK_TRACK_CACHE_SIZE);
     disk_init_all_channels(image, channels);
 
     disk_last_error = DISK_STATUS_INIT;
@@ -1298,11 +1459,38 @@ static void disk_loop(void)
         u8 reply = disk_send_command(cmd, channels);
         cmd = CMD_NONE;
 
+        // LOAD was aborted
+        if (reply != REPLY_LOAD_NEXT)
+        {
+            disk_load_end();
+        }
+
+        // Flush data written by BSOUT before UNLISTEN, CLOSE, etc.
+        if (reply != REPLY_RECEIVE_BYTE && KFF_BSOUT_COUNT &&
+            disk_handle_receive_byte(listen) == CMD_DISK_ERROR)
+        {
+            // The reply to this command can't report the error. Report
+            // it in the disk status instead (same as BSOUT would)
+            wrn("Failed to write BSOUT data");
+            disk_last_error = DISK_STATUS_EXISTS;
+        }
+
+        // KFF_BASIN_BUF is kept while reading from the same channel
+        if (reply != REPLY_TALK && reply != REPLY_UNTALK &&
+            reply != REPLY_SEND_BYTE)
+        {
+            disk_basin_release();
+        }
+
         switch (reply)
         {
             case REPLY_OK:
                 break;
 
+            case REPLY_LOAD_NEXT:
+                cmd = disk_handle_load_next();
+                break;
+
             case REPLY_LOAD:
                 // Channel 0 will be used as load buffer - just as on 1541
                 channel = channels + 0;
@@ -1335,6 +1523,10 @@ static void disk_loop(void)
 
             case REPLY_TALK:
                 talk = disk_receive_channel(channels);
+                if (talk != basin_channel)
+                {
+                    disk_basin_release();
+                }
                 break;
 
             case REPLY_UNTALK:
@@ -23,6 +23,19 @@ static const u16 dir_link_addr = 0x0101;
 
 static u8 disk_last_error;
 
+// Buffered BASIN (align with disk.s)
+#define KFF_BASIN_BUF   (KFF_BUF + 0x3f00)
+#define KFF_BASIN_COUNT (*((volatile u8*)(KFF_RAM + 0x08)))
+#define KFF_BASIN_PTR   (*((volatile u8*)(KFF_RAM + 0x09)))
+
+// Buffered BSOUT (align with disk.s)
+#define KFF_BSOUT_BUF   (KFF_BUF + 0x3e00)
+#define KFF_BSOUT_COUNT (*((volatile u8*)(KFF_RAM + 0x0a)))
+
+// LOAD is sent in chunks (align with disk.s)
+#define KFF_LOAD_CHUNK_SIZE (8*1024)
+#define KFF_LOAD_NEXT_BUF   (KFF_BUF + 0x4000)
+
 typedef enum
 {
     DISK_STATUS_OK          = 00,
@@ -72,4 +85,22 @@ typedef struct
     D64 d64;
     DIR_t dir;
     FIL file;
+
+    // Data sent to the C64 in a single BASIN request
+    u8 basin_len;
+    u8 basin_ptr;
+    bool basin_eof;     // Last byte is end of file
+    u8 basin_buf[255];
 } DISK_CHANNEL;
+
+static DISK_CHANNEL *basin_channel; // Channel with data in KFF_BASIN_BUF
+
+typedef struct
+{
+    DISK_CHANNEL *channel;  // Channel with LOAD in progress
+    u32 left;               // Max bytes left to load
+    u16 next_size;
+    bool next_ready;        // Next chunk in KFF_LOAD_NEXT_BUF
+} DISK_LOAD;
+
+static DISK_LOAD disk_load;
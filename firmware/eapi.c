@@ -18,7 +18,15 @@
  * 3. This notice may not be removed or altered from any source distribution.
  */
 
-static void eapi_open_dat(FIL *file)
+typedef struct
+{
+    FIL file;
+    u32 offset;                 // File offset of the next block
+    u16 last;                   // Offset of the last record in the block
+    DAT_JOURNAL_BLOCK block;
+} EAPI_JOURNAL;
+
+static void eapi_open_dat(FIL *file, DWORD *clmt)
 {
     if (!file_open(file, DAT_FILENAME, FA_READ|FA_WRITE)
         || f_size(file) != (sizeof(dat_file) + sizeof(dat_buffer)))
@@ -26,6 +34,11 @@ static void eapi_open_dat(FIL *file)
         err(DAT_FILENAME " file not found or invalid");
         restart_to_menu();
     }
+
+    file_fast_seek(file, clmt);
+
+    // File is written without save_dat()
+    dat_crc = 0;
 }
 
 static void eapi_save_header(FIL *file)
@@ -39,36 +52,96 @@ static void eapi_save_header(FIL *file)
     }
 }
 
-static void eapi_load_buffer(FIL *file)
+static void eapi_load_buffer(FIL *file, EAPI_JOURNAL *journal)
 {
     if (!file_seek(file, sizeof(dat_file)) ||
-        file_read(file, &dat_buffer, sizeof(dat_buffer)) != sizeof(dat_buffer))
+        file_read(file, &dat_buffer, sizeof(dat_buffer)) != sizeof(dat_buffer) ||
+        !file_seek(&journal->file, 0))
     {
         err("Failed to load dat buffer");
         restart_to_menu();
     }
+
+    // Apply the writes not yet in the DAT file
+    dat_journal_replay(&journal->file);
 }
 
-static void eapi_save_buffer(FIL *file)
+static void eapi_open_journal(EAPI_JOURNAL *journal)
 {
-    if (!file_seek(file, sizeof(dat_file)) ||
-        file_write(file, &dat_buffer, sizeof(dat_buffer)) != sizeof(dat_buffer) ||
-        !file_sync(file))
+    if (!file_open(&journal->file, DAT_JOURNAL_FILENAME,
+                   FA_READ|FA_WRITE|FA_OPEN_ALWAYS))
     {
-        err("Failed to save dat buffer");
         restart_to_menu();
     }
+
+    // Append after any existing blocks
+    journal->offset = (f_size(&journal->file) + 511) & ~511;
+    journal->block.size = 0;
+    journal->last = 0;
 }
 
-static void eapi_save_buffer_byte(FIL *file, u16 pos, u8 byte, bool sync)
+static void eapi_journal_flush(EAPI_JOURNAL *journal)
 {
-    if (!file_seek(file, sizeof(dat_file) + pos) ||
-        file_write(file, &byte, 1) != 1 ||
-        (sync && !file_sync(file)))
+    if (!journal->block.size)
     {
-        err("Failed to save dat buffer byte");
+        return;
+    }
+
+    // Blocks are never overwritten to keep the journal valid on power loss
+    journal->block.crc = dat_journal_block_crc(&journal->block);
+    if (!file_seek(&journal->file, journal->offset) ||
+        file_write(&journal->file, &journal->block,
+                   sizeof(DAT_JOURNAL_BLOCK)) != sizeof(DAT_JOURNAL_BLOCK) ||
+        !file_sync(&journal->file))
+    {
+        err("Failed to write journal");
         restart_to_menu();
     }
+
+    journal->offset += sizeof(DAT_JOURNAL_BLOCK);
+    journal->block.size = 0;
+}
+
+static void eapi_journal_add(EAPI_JOURNAL *journal, u16 pos, u16 len, bool fill)
+{
+    DAT_JOURNAL_BLOCK *block = &journal->block;
+    while (len)
+    {
+        u16 space = sizeof(block->data) - block->size;
+
+        // Extend the last record if contiguous
+        DAT_JOURNAL_RECORD *last = (DAT_JOURNAL_RECORD *)(block->data + journal->last);
+        if (!fill && block->size && !(last->len & DAT_JOURNAL_FILL) &&
+            last->pos + last->len == pos && space)
+        {
+            u16 size = len < space ? len : space;
+            memcpy(block->data + block->size, dat_buffer + pos, size);
+            block->size += size;
+            last->len += size;
+            pos += size;
+            len -= size;
+            continue;
+        }
+
+        if (space <= sizeof(DAT_JOURNAL_RECORD))
+        {
+            eapi_journal_flush(journal);
+            continue;
+        }
+
+        journal->last = block->size;
+        last = (DAT_JOURNAL_RECORD *)(block->data + block->size);
+        last->pos = pos;
+        block->size += sizeof(DAT_JOURNAL_RECORD);
+
+        if (fill)
+        {
+            last->len = len | DAT_JOURNAL_FILL;
+            break;
+        }
+
+        last->len = 0;
+    }
 }
 
 static void eapi_disable_interface(void)
@@ -84,7 +157,8 @@ static void eapi_enable_interface(void)
     ef3_send_data("DONE", 4);
 }
 
-static void eapi_handle_write_flash(FIL *file, u16 addr, u8 value)
+static void eapi_handle_write_flash(FIL *file, EAPI_JOURNAL *journal,
+                                    u16 addr, u8 value)
 {
     u8 *dest = crt_ptr + (addr & 0x3fff);
     if (crt_ptr >= crt_banks[0] && crt_ptr <= crt_banks[3])
@@ -92,27 +166,27 @@ static void eapi_handle_write_flash(FIL *file, u16 addr, u8 value)
         *dest &= value;
         u16 pos = (u16)(dest - crt_banks[0]);
 
-        eapi_disable_interface();
+        // SD card writes use DMA, no need to disable the C64 interface
         if (!(dat_file.crt.flags & CRT_FLAG_UPDATED))
         {
             dat_file.crt.flags |= CRT_FLAG_UPDATED;
             eapi_save_header(file);
         }
 
-        // Only sync to file at end of bank low/high.
-        // This is much faster but doesn't allow random access
-        bool sync = (addr & 0x1fff) == 0x1fff;
-        eapi_save_buffer_byte(file, pos, *dest, sync);
-        eapi_enable_interface();
+        // Only write the journal at end of bank low/high or when a
+        // journal block is full
+        eapi_journal_add(journal, pos, 1, false);
+        if ((addr & 0x1fff) == 0x1fff)
+        {
+            eapi_journal_flush(journal);
+        }
     }
     else
     {
         if (!(dat_file.crt.flags & CRT_FLAG_UPDATED))
         {
             dat_file.crt.flags |= CRT_FLAG_UPDATED;
-            eapi_disable_interface();
             eapi_save_header(file);
-            eapi_enable_interface();
         }
 
         flash_program_byte(dest, value);
@@ -128,7 +202,63 @@ static void eapi_handle_write_flash(FIL *file, u16 addr, u8 value)
     ef3_send_reply(result);
 }
 
-static void eapi_handle_erase_sector(FIL *file, u8 bank, u16 addr)
+static void eapi_handle_write_flash_block(FIL *file, EAPI_JOURNAL *journal,
+                                          u16 addr, u16 size)
+{
+    // Block must be within a single 8k bank
+    if ((addr & 0x1fff) + size > 8*1024)
+    {
+        wrn("Got invalid block to write: $%04x (%u)", addr, size);
+        ef3_send_reply(REPLY_WRITE_ERROR);
+        return;
+    }
+
+    u8 buf[256];
+    ef3_send_reply(REPLY_EAPI_OK);
+    ef3_receive_data(buf, size);
+
+    if (!(dat_file.crt.flags & CRT_FLAG_UPDATED))
+    {
+        dat_file.crt.flags |= CRT_FLAG_UPDATED;
+        eapi_save_header(file);
+    }
+
+    u8 *dest = crt_ptr + (addr & 0x3fff);
+    if (crt_ptr >= crt_banks[0] && crt_ptr <= crt_banks[3])
+    {
+        for (u16 i=0; i<size; i++)
+        {
+            dest[i] &= buf[i];
+        }
+
+        // Single journal write for the whole block
+        u16 pos = (u16)(dest - crt_banks[0]);
+        eapi_journal_add(journal, pos, size, false);
+        eapi_journal_flush(journal);
+    }
+    else
+    {
+        for (u16 i=0; i<size; i++)
+        {
+            if (dest[i] != buf[i])
+            {
+                flash_program_byte(dest + i, buf[i]);
+            }
+        }
+    }
+
+    u8 result = REPLY_EAPI_OK;
+    if (memcmp(dest, buf, size) != 0)
+    {
+        wrn("Flash block write failed at $%04x (%x)", addr, crt_ptr);
+        result = REPLY_WRITE_ERROR;
+    }
+
+    ef3_send_reply(result);
+}
+
+static void eapi_handle_erase_sector(FIL *file, EAPI_JOURNAL *journal,
+                                     u8 bank, u16 addr)
 {
     if (bank >= 64 || (bank % 8))
     {
@@ -174,12 +304,17 @@ static void eapi_handle_erase_sector(FIL *file, u8 bank, u16 addr)
             sector_to_erase = -1;
 
             memset(crt_banks[i] + offset, 0xff, 8*1024);
+            eapi_journal_add(journal, (u16)(crt_banks[i] + offset - crt_banks[0]),
+                             8*1024, true);
         }
 
-        eapi_save_buffer(file);
+        eapi_journal_flush(journal);
     }
     else
     {
+        // dat_buffer is restored from the DAT file and the journal
+        eapi_journal_flush(journal);
+
         // Backup other 64k of 128k flash sector in dat_buffer
         for (u8 i=0; i<8; i++)
         {
@@ -197,7 +332,7 @@ static void eapi_handle_erase_sector(FIL *file, u8 bank, u16 addr)
         }
 
         // Restore dat_buffer
-        eapi_load_buffer(file);
+        eapi_load_buffer(file, journal);
     }
 
     eapi_enable_interface();
@@ -207,10 +342,14 @@ static void eapi_handle_erase_sector(FIL *file, u8 bank, u16 addr)
 static void eapi_loop(void)
 {
     FIL file;
+    DWORD clmt[FILE_CLMT_SIZE];
+    EAPI_JOURNAL journal;
     u16 addr;
     u8 value;
 
-    eapi_open_dat(&file);
+    eapi_open_dat(&file, clmt);
+    eapi_open_journal(&journal);
+    sdio_set_bounce_buffer(SDIO_BOUNCE_BUF);
     while (true)
     {
         u8 command = ef3_receive_command();
@@ -230,7 +369,7 @@ static void eapi_loop(void)
             {
                 ef3_receive_data(&addr, 2);
                 value = ef3_receive_byte();
-                eapi_handle_write_flash(&file, addr, value);
+                eapi_handle_write_flash(&file, &journal, addr, value);
             }
             break;
 
@@ -239,7 +378,16 @@ static void eapi_loop(void)
                 ef3_receive_data(&addr, 2);
                 value = ef3_receive_byte();
                 dbg("Got ERASE_SECTOR command (%u:$%04x)", value, addr);
-                eapi_handle_erase_sector(&file, value, addr);
+                eapi_handle_erase_sector(&file, &journal, value, addr);
+            }
+            break;
+
+            case CMD_WRITE_FLASH_BLOCK:
+            {
+                ef3_receive_data(&addr, 2);
+                u16 size = ef3_receive_byte();
+                eapi_handle_write_flash_block(&file, &journal, addr,
+                                              size ? size : 256);
             }
             break;
 
@@ -172,7 +172,8 @@ typedef enum
     DAT_FLAG_AUTOSTART_D64      = 0x02,
     DAT_FLAG_DEVICE_NUM_D64_1   = 0x04,
     DAT_FLAG_DEVICE_NUM_D64_2   = 0x08,
-    DAT_FLAG_DEVICE_NUM_D64_3   = 0x10
+    DAT_FLAG_DEVICE_NUM_D64_3   = 0x10,
+    DAT_FLAG_SORT_DIR           = 0x20
 } DAT_FLAGS;
 
 #define DAT_FLAG_DEVICE_D64_POS 0x02
@@ -249,9 +250,29 @@ typedef struct
     char path[736];
     char file[256];
 } DAT_HEADER;
+
+// EAPI writes to dat_buffer are appended to a journal file in blocks of 512
+// bytes and applied to the DAT file by load_dat()
+typedef struct
+{
+    u16 pos;            // Offset in dat_buffer
+    u16 len;            // Number of data bytes following (or DAT_JOURNAL_FILL)
+} DAT_JOURNAL_RECORD;
+
+typedef struct
+{
+    u16 size;           // Bytes used in data
+    u8 data[506];       // DAT_JOURNAL_RECORDs
+    u32 crc;            // CRC of size and data
+} DAT_JOURNAL_BLOCK;
 #pragma pack(pop)
 
+#define DAT_JOURNAL_FILL    0x8000  // Fill len bytes with $ff (no data)
+
 #define ELEMENT_NOT_SELECTED 0xffff
 #define DAT_SIGNATURE "KungFu:\1"
 
 static DAT_HEADER dat_file;
+
+// CRC of dat_file and dat_buffer as last loaded or saved (0 if unknown)
+static u32 dat_crc;
@@ -21,8 +21,28 @@
 // Use a different name for DIR to avoid conflict with the POSIX type
 #define DIR_t DIR
 
+// Cluster link map table size for fast seek (allows 15 fragments)
+#define FILE_CLMT_SIZE 32
+
 static FATFS fs;
 
+// Incremented when files are created or deleted
+static u32 fs_changes;
+
+// Sequential reader that reads the next buffer in the background (DMA)
+typedef struct
+{
+    FIL *file;
+    u8 *buf[2];
+    u32 buf_size;   // Size of each buffer (multiple of 512)
+    u32 len[2];     // Valid bytes in each buffer
+    FSIZE_t offset; // File offset of the current buffer
+    u32 pos;        // Read position in the current buffer
+    u8 current;
+    bool pending;   // Background read in progress
+    bool error;
+} FILE_STREAM;
+
 static bool filesystem_mount(void)
 {
     FRESULT res = f_mount(&fs, "", 1);
@@ -71,6 +91,11 @@ static bool filesystem_getlabel(char *label)
 
 static bool file_open(FIL *file, const char *file_name, u8 mode)
 {
+    if (mode & (FA_CREATE_NEW|FA_CREATE_ALWAYS|FA_OPEN_ALWAYS))
+    {
+        fs_changes++;
+    }
+
     FRESULT res = f_open(file, file_name, mode);
     if (res != FR_OK)
     {
@@ -107,6 +132,24 @@ static bool file_seek(FIL *file, FSIZE_t offset)
     return res == FR_OK;
 }
 
+static bool file_fast_seek(FIL *file, DWORD *clmt)
+{
+    // Create cluster link map table to avoid following the FAT chain on seek
+    clmt[0] = FILE_CLMT_SIZE;
+    file->cltbl = clmt;
+
+    FRESULT res = f_lseek(file, CREATE_LINKMAP);
+    if (res != FR_OK)
+    {
+        // File is too fragmented (or too large)
+        wrn("Fast seek not possible (%u)", res);
+        file->cltbl = NULL;
+    }
+
+    led_on();
+    return res == FR_OK;
+}
+
 static u32 file_write(FIL *file, void *buffer, size_t bytes)
 {
     UINT bytes_written;
@@ -171,6 +214,8 @@ static bool file_stat(const char *file_name, FILINFO *file_info)
 
 static bool file_delete(const char *file_name)
 {
+    fs_changes++;
+
     FRESULT res = f_unlink(file_name);
     if (res != FR_OK)
     {
@@ -181,6 +226,208 @@ static bool file_delete(const char *file_name)
     return res == FR_OK;
 }
 
+static DWORD file_sector(FIL *file, FSIZE_t offset, u32 *contiguous)
+{
+    // Requires a cluster link map table (see file_fast_seek)
+    if (!file->cltbl)
+    {
+        return 0;
+    }
+
+    DWORD *tbl = file->cltbl + 1;
+    DWORD cluster = offset / 512 / fs.csize;
+    DWORD fragment;
+    while (true)
+    {
+        fragment = *tbl++;  // Number of clusters in the fragment
+        if (!fragment)
+        {
+            return 0;
+        }
+
+        if (cluster < fragment)
+        {
+            break;
+        }
+        cluster -= fragment;
+        tbl++;
+    }
+
+    u32 sector = (offset / 512) % fs.csize;
+    *contiguous = (fragment - cluster) * fs.csize - sector;
+    return fs.database + (*tbl + cluster - 2) * fs.csize + sector;
+}
+
+static void file_stream_fill(FILE_STREAM *stream, u8 idx, FSIZE_t offset)
+{
+    u32 bytes = 0;
+    FSIZE_t size = f_size(stream->file);
+    if (offset < size)
+    {
+        bytes = size - offset;
+        if (bytes > stream->buf_size)
+        {
+            bytes = stream->buf_size;
+        }
+    }
+
+    stream->len[idx] = bytes;
+    if (!bytes)
+    {
+        return;
+    }
+
+    u32 count = (bytes + 511) / 512;
+    u32 contiguous = 0;
+    DWORD sector = file_sector(stream->file, offset, &contiguous);
+    if (sector && contiguous >= count)
+    {
+        disk_read_start(stream->buf[idx], sector, count);
+        stream->pending = true;
+        return;
+    }
+
+    // Crosses a fragment boundary. Read it the normal way
+    if (!file_seek(stream->file, offset) ||
+        file_read(stream->file, stream->buf[idx], bytes) != bytes)
+    {
+        stream->error = true;
+    }
+}
+
+static bool file_stream_wait(FILE_STREAM *stream)
+{
+    if (stream->pending)
+    {
+        stream->pending = false;
+        DRESULT res = disk_read_finish();
+        if (res != RES_OK)
+        {
+            err("disk_read failed (%u)", res);
+            stream->error = true;
+        }
+
+        led_on();
+    }
+
+    return !stream->error;
+}
+
+// Completes the pending read if all data has been received
+static void file_stream_poll(FILE_STREAM *stream)
+{
+    if (stream->pending)
+    {
+        disk_read_poll();
+    }
+}
+
+static bool file_stream_open(FILE_STREAM *stream, FIL *file, FSIZE_t offset,
+                             u8 *buf, u32 buf_size)
+{
+    // Buffer must be DMA capable and is split in two
+    stream->file = file;
+    stream->buf_size = (buf_size / 2) & ~511;
+    stream->buf[0] = buf;
+    stream->buf[1] = buf + stream->buf_size;
+    stream->offset = offset & ~511;
+    stream->pos = offset & 511;
+    stream->current = 0;
+    stream->pending = false;
+    stream->error = false;
+
+    file_stream_fill(stream, 0, stream->offset);
+    if (!file_stream_wait(stream))
+    {
+        return false;
+    }
+
+    file_stream_fill(stream, 1, stream->offset + stream->buf_size);
+    return true;
+}
+
+static bool file_stream_next(FILE_STREAM *stream)
+{
+    if (!file_stream_wait(stream))
+    {
+        return false;
+    }
+
+    stream->offset += stream->buf_size;
+    stream->pos = 0;
+    stream->current ^= 1;
+    if (!stream->len[stream->current])
+    {
+        return false;
+    }
+
+    // Start reading into the buffer just consumed
+    file_stream_fill(stream, stream->current ^ 1,
+                     stream->offset + stream->buf_size);
+    return true;
+}
+
+// Returns a pointer to up to the requested number of bytes without copying
+static u8 * file_stream_peek(FILE_STREAM *stream, u32 *bytes)
+{
+    if (stream->pos >= stream->len[stream->current] &&
+        !file_stream_next(stream))
+    {
+        *bytes = 0;
+        return NULL;
+    }
+
+    u32 left = stream->len[stream->current] - stream->pos;
+    if (*bytes > left)
+    {
+        *bytes = left;
+    }
+
+    return stream->buf[stream->current] + stream->pos;
+}
+
+static u32 file_stream_read(FILE_STREAM *stream, void *buffer, u32 bytes)
+{
+    u8 *dest = (u8 *)buffer;
+    u32 bytes_read = 0;
+    while (bytes_read < bytes)
+    {
+        u32 size = bytes - bytes_read;
+        u8 *src = file_stream_peek(stream, &size);
+        if (!src)
+        {
+            break;
+        }
+
+        if (dest)
+        {
+            memcpy(dest + bytes_read, src, size);
+        }
+        stream->pos += size;
+        bytes_read += size;
+    }
+
+    return bytes_read;
+}
+
+static bool file_stream_skip(FILE_STREAM *stream, u32 bytes)
+{
+    return file_stream_read(stream, NULL, bytes) == bytes;
+}
+
+static bool file_stream_eof(FILE_STREAM *stream)
+{
+    return stream->offset + stream->pos >= f_size(stream->file);
+}
+
+static bool file_stream_close(FILE_STREAM *stream)
+{
+    // Must complete before any other access to the SD card
+    bool result = file_stream_wait(stream);
+    led_on();
+    return result;
+}
+
 static bool dir_change(const char *path)
 {
     FRESULT res = f_chdir(path);
@@ -19,6 +19,7 @@
  */
 
 #define DAT_FILENAME "/KungFuFlash.dat"
+#define DAT_JOURNAL_FILENAME "/KungFuFlash.jnl"
 
 #define CRT_C64_SIGNATURE  "C64 CARTRIDGE   "
 #define CRT_C128_SIGNATURE "C128 CARTRIDGE  "
@@ -160,12 +161,9 @@ static bool crt_write_header(FIL *file, u16 type, u8 exrom, u8 game, const char
     return len == sizeof(CRT_HEADER);
 }
 
-static bool crt_load_chip_header(FIL *file, CRT_CHIP_HEADER *header)
+static bool crt_check_chip_header(CRT_CHIP_HEADER *header)
 {
-    u32 len = file_read(file, header, sizeof(CRT_CHIP_HEADER));
-
-    if (len != sizeof(CRT_CHIP_HEADER) ||
-        memcmp(CRT_CHIP_SIGNATURE, header->signature, sizeof(header->signature)) != 0)
+    if (memcmp(CRT_CHIP_SIGNATURE, header->signature, sizeof(header->signature)) != 0)
     {
         return false;
     }
@@ -185,6 +183,12 @@ static bool crt_load_chip_header(FIL *file, CRT_CHIP_HEADER *header)
     return true;
 }
 
+static bool crt_load_chip_header(FIL *file, CRT_CHIP_HEADER *header)
+{
+    u32 len = file_read(file, header, sizeof(CRT_CHIP_HEADER));
+    return len == sizeof(CRT_CHIP_HEADER) && crt_check_chip_header(header);
+}
+
 static bool crt_write_chip_header(FIL *file, u8 type, u8 bank, u16 address, u16 size)
 {
     CRT_CHIP_HEADER header;
@@ -251,13 +255,61 @@ static s32 crt_get_offset(CRT_CHIP_HEADER *header, u16 cartridge_type)
     return offset;
 }
 
-static u8 crt_program_file(FIL *crt_file, u16 cartridge_type)
+static bool crt_bank_empty(u8 *buf, u16 size)
+{
+    u32 *buf32 = (u32 *)buf;
+    for (u16 i=0; i<size/4; i++)
+    {
+        if (buf32[i] != 0xffffffff)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Flash is handled in 4k units (64 banks of 16k) and 8 sectors of 128k
+#define CRT_FLASH_UNITS     (64*4)
+#define CRT_FLASH_SECTORS   8
+
+typedef struct
+{
+    u32 units[CRT_FLASH_UNITS/32];  // 4k units used by the CRT file
+    bool changed[CRT_FLASH_SECTORS];
+    bool erase[CRT_FLASH_SECTORS];  // Changed bits cannot be programmed
+    bool erased[CRT_FLASH_SECTORS];
+} CRT_FLASH_STATE;
+
+// Last calculated flash hash. Valid until the flash is programmed again
+static u32 crt_flash_hash;
+
+static bool crt_flash_unit_used(CRT_FLASH_STATE *state, u32 unit)
+{
+    return state->units[unit/32] & (1u << (unit%32));
+}
+
+static bool crt_flash_programmable(u8 *flash, u8 *buf, u16 size)
+{
+    // Flash bits can be programmed from 1 to 0 without an erase
+    u32 *flash32 = (u32 *)flash;
+    u32 *buf32 = (u32 *)buf;
+    for (u16 i=0; i<size/4; i++)
+    {
+        if ((flash32[i] & buf32[i]) != buf32[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static u8 crt_load_chips(FIL *crt_file, u16 cartridge_type,
+                         CRT_FLASH_STATE *state)
 {
     u8 *flash_buffer = (u8 *)FLASH_BASE;
     u8 banks_in_use = 0;
-    bool sector_erased[8] = {0};
-
-    memset(dat_buffer, 0xff, sizeof(dat_buffer));
 
     while (!f_eof(crt_file))
     {
@@ -300,20 +352,34 @@ static u8 crt_program_file(FIL *crt_file, u16 cartridge_type)
         if (header.bank >= 4 && header.bank < 64)
         {
             u8 *flash_ptr = flash_buffer + offset;
-            s8 sector_to_erase = -1;
-
             u8 sector = header.bank / 8;
-            if (!sector_erased[sector])
+
+            // Compare with the image already in flash
+            for (u32 unit = offset / (4*1024);
+                 unit < (offset + header.image_size + 4*1024-1) / (4*1024);
+                 unit++)
             {
-                sector_erased[sector] = true;
-                sector_to_erase = sector + 4;
-                led_off();
+                if (crt_flash_unit_used(state, unit))
+                {
+                    state->changed[sector] = true;
+                    state->erase[sector] = true;
+                }
+                state->units[unit/32] |= 1u << (unit%32);
             }
 
-            flash_sector_program(sector_to_erase, flash_ptr, scratch_buf,
-                                 header.image_size);
+            if (memcmp(flash_ptr, scratch_buf, header.image_size) != 0)
+            {
+                state->changed[sector] = true;
+                if (!crt_flash_programmable(flash_ptr, (u8 *)scratch_buf,
+                                            header.image_size))
+                {
+                    state->erase[sector] = true;
+                }
+            }
         }
-        // Skip image
+        // Skip image. Banks above 64 cannot be selected by the bank register
+        // of the supported cartridges. Serving them from the SD card is not
+        // possible either, as the C64 cannot be halted while a bank is read
         else if (header.bank >= 64)
         {
             wrn("No room for CRT chip bank %u at $%x",
@@ -327,10 +393,177 @@ static u8 crt_program_file(FIL *crt_file, u16 cartridge_type)
         }
     }
 
-    // Erase any gaps to minimize generated CRT file
-    for (u8 sector=0; sector<banks_in_use/8; sector++)
+    return banks_in_use;
+}
+
+// Programming 1k takes about 4 ms
+#define CRT_PROGRAM_CHUNK   1024
+
+static u8 crt_program_chips(FIL *crt_file, FSIZE_t chips_offset,
+                            u16 cartridge_type, CRT_FLASH_STATE *state)
+{
+    // The next part of the file is read by DMA while the flash is programmed
+    FILE_STREAM stream;
+    if (!file_stream_open(&stream, crt_file, chips_offset, (u8 *)scratch_buf,
+                          sizeof(scratch_buf)))
+    {
+        return 0;
+    }
+
+    u8 *flash_buffer = (u8 *)FLASH_BASE;
+    u8 banks_in_use = 0;
+
+    while (!file_stream_eof(&stream))
+    {
+        CRT_CHIP_HEADER header;
+        if (file_stream_read(&stream, &header, sizeof(CRT_CHIP_HEADER)) !=
+            sizeof(CRT_CHIP_HEADER) || !crt_check_chip_header(&header))
+        {
+            err("Failed to read CRT chip header");
+            banks_in_use = 0;
+            break;
+        }
+
+        s32 offset = crt_get_offset(&header, cartridge_type);
+        if (offset == -1)
+        {
+            banks_in_use = 0;
+            break;
+        }
+
+        u8 sector = header.bank / 8;
+        u32 left = header.image_size;
+
+        // Banks 0-3 were placed in dat_buffer by the compare pass
+        if (header.bank >= 4 && header.bank < 64 && state->changed[sector])
+        {
+            // Erase when the first image in the sector is reached
+            s8 sector_to_erase = -1;
+            if (state->erase[sector] && !state->erased[sector])
+            {
+                state->erased[sector] = true;
+                sector_to_erase = sector + 4;
+                led_off();
+            }
+
+            u8 *flash_ptr = flash_buffer + offset;
+            while (left)
+            {
+                // The read must be stopped before the erase which can take
+                // a second
+                if (sector_to_erase >= 0 && !file_stream_wait(&stream))
+                {
+                    break;
+                }
+
+                // Program in small chunks to stop the read soon after it is
+                // done
+                u32 size = left;
+                if (size > CRT_PROGRAM_CHUNK)
+                {
+                    size = CRT_PROGRAM_CHUNK;
+                }
+
+                u8 *buf = file_stream_peek(&stream, &size);
+                if (!buf)
+                {
+                    break;
+                }
+
+                flash_sector_program(sector_to_erase, flash_ptr, buf, size);
+                file_stream_poll(&stream);
+                sector_to_erase = -1;
+                flash_ptr += size;
+                left -= size;
+                file_stream_skip(&stream, size);
+            }
+        }
+        else if (file_stream_skip(&stream, left))
+        {
+            left = 0;
+        }
+
+        if (left)
+        {
+            err("Failed to read CRT chip image. Bank %u at $%x",
+                header.bank, header.start_address);
+            banks_in_use = 0;
+            break;
+        }
+
+        if (header.bank < 64 && banks_in_use < (header.bank + 1))
+        {
+            banks_in_use = header.bank + 1;
+        }
+    }
+
+    if (!file_stream_close(&stream))
+    {
+        banks_in_use = 0;
+    }
+
+    return banks_in_use;
+}
+
+static u8 crt_program_file(FIL *crt_file, u16 cartridge_type)
+{
+    CRT_FLASH_STATE state = {0};
+    FSIZE_t chips_offset = f_tell(crt_file);
+    crt_flash_hash = 0;
+
+    // Allows the file to be read directly by sector
+    DWORD clmt[FILE_CLMT_SIZE];
+    file_fast_seek(crt_file, clmt);
+
+    memset(dat_buffer, 0xff, sizeof(dat_buffer));
+
+    // Only sectors that differ from the flash content are programmed and
+    // only erased if needed
+    u8 banks_in_use = crt_load_chips(crt_file, cartridge_type, &state);
+
+    // Unused parts of the sectors must be erased to minimize generated CRT
+    // file (this also applies to any gaps and to the end of the last sector)
+    u8 *flash_buffer = (u8 *)FLASH_BASE;
+    u8 sectors = (banks_in_use + 7) / 8;
+    u8 sectors_changed = 0;
+    u8 sectors_erased = 0;
+    for (u8 sector=0; sector<sectors; sector++)
+    {
+        u32 unit = sector ? sector * 8*4 : 4*4;
+        u32 end_unit = (sector+1) * 8*4;
+        for (; !state.erase[sector] && unit < end_unit; unit++)
+        {
+            if (!crt_flash_unit_used(&state, unit) &&
+                !crt_bank_empty(flash_buffer + unit * 4*1024, 4*1024))
+            {
+                state.changed[sector] = true;
+                state.erase[sector] = true;
+            }
+        }
+
+        if (state.changed[sector])
+        {
+            sectors_changed++;
+            if (state.erase[sector])
+            {
+                sectors_erased++;
+            }
+        }
+    }
+
+    dbg("CRT flash sectors changed: %u of %u (%u erased)", sectors_changed,
+        sectors, sectors_erased);
+    flash_stats_reset();
+    if (sectors_changed)
+    {
+        banks_in_use = crt_program_chips(crt_file, chips_offset,
+                                         cartridge_type, &state);
+    }
+
+    // Erase changed sectors without any images
+    for (u8 sector=0; sector<sectors && banks_in_use; sector++)
     {
-        if (!sector_erased[sector])
+        if (state.erase[sector] && !state.erased[sector])
         {
             u8 sector_to_erase = sector + 4;
             led_toggle();
@@ -338,6 +571,11 @@ static u8 crt_program_file(FIL *crt_file, u16 cartridge_type)
         }
     }
 
+    flash_stats_print();
+
+    // Link map table is on the stack
+    crt_file->cltbl = NULL;
+
     led_on();
     return banks_in_use;
 }
@@ -352,20 +590,6 @@ static bool crt_write_chip(FIL *file, u8 bank, u16 address, u16 size, void *buf)
     return file_write(file, buf, size) == size;
 }
 
-static bool crt_bank_empty(u8 *buf, u16 size)
-{
-    u32 *buf32 = (u32 *)buf;
-    for (u16 i=0; i<size/4; i++)
-    {
-        if (buf32[i] != 0xffffffff)
-        {
-            return false;
-        }
-    }
-
-    return true;
-}
-
 static bool crt_write_file(FIL *crt_file, u8 banks)
 {
     const u16 chip_size = 8*1024;
@@ -407,7 +631,8 @@ static u32 crt_calc_flash_crc(u8 banks)
         crc_calc(flash_buffer, flash_used);
     }
 
-    return crc_get();
+    crt_flash_hash = crc_get();
+    return crt_flash_hash;
 }
 
 static bool upd_load(FIL *file, char *firmware_name)
@@ -457,14 +682,224 @@ static bool mount_sd_card(void)
     return dir_change("/");
 }
 
+// CRC of each sector in the KungFuFlash.dat file as last loaded or saved
+#define DAT_SECTORS ((sizeof(dat_file) + sizeof(dat_buffer)) / 512)
+static u32 dat_sector_crc[DAT_SECTORS];
+
+static u8 * dat_sector_ptr(u32 sector)
+{
+    u32 offset = sector * 512;
+    if (offset < sizeof(dat_file))
+    {
+        return (u8 *)&dat_file + offset;
+    }
+
+    return dat_buffer + (offset - sizeof(dat_file));
+}
+
+static u32 dat_sector_calc_crc(u32 sector)
+{
+    crc_reset();
+    crc_calc(dat_sector_ptr(sector), 512);
+    return crc_get();
+}
+
+static void dat_crc_update(void)
+{
+    crc_reset();
+    crc_calc(dat_sector_crc, sizeof(dat_sector_crc));
+    dat_crc = crc_get();
+}
+
+static void dat_sector_crc_update(void)
+{
+    for (u32 sector=0; sector<DAT_SECTORS; sector++)
+    {
+        dat_sector_crc[sector] = dat_sector_calc_crc(sector);
+    }
+
+    dat_crc_update();
+}
+
+static bool dat_buffer_loaded(u32 expected_crc)
+{
+    if (!expected_crc)
+    {
+        return false;
+    }
+
+    dat_sector_crc_update();
+    return dat_crc == expected_crc;
+}
+
+static bool save_dat_changes(void)
+{
+    // Only write the sectors that have changed since the file was loaded
+    FIL file;
+    if (!dat_crc || !file_open(&file, DAT_FILENAME, FA_WRITE))
+    {
+        return false;
+    }
+
+    bool file_saved = f_size(&file) == DAT_SECTORS * 512;
+    u32 sectors_written = 0;
+    for (u32 sector=0; sector<DAT_SECTORS && file_saved; sector++)
+    {
+        u32 crc = dat_sector_calc_crc(sector);
+        if (crc == dat_sector_crc[sector])
+        {
+            continue;
+        }
+
+        if (!file_seek(&file, sector * 512) ||
+            file_write(&file, dat_sector_ptr(sector), 512) != 512)
+        {
+            file_saved = false;
+            break;
+        }
+
+        dat_sector_crc[sector] = crc;
+        sectors_written++;
+    }
+
+    file_close(&file);
+    dbg("Saved %u of %u sectors", sectors_written, DAT_SECTORS);
+
+    if (file_saved)
+    {
+        dat_crc_update();
+    }
+
+    return file_saved;
+}
+
+static bool save_dat(void)
+{
+    dbg("Saving " DAT_FILENAME " file");
+    if (save_dat_changes())
+    {
+        return true;
+    }
+
+    FIL file;
+    if (!file_open(&file, DAT_FILENAME, FA_WRITE|FA_CREATE_ALWAYS))
+    {
+        wrn("Could not open " DAT_FILENAME " for writing");
+        return false;
+    }
+
+    bool file_saved = false;
+    if (file_write(&file, &dat_file, sizeof(dat_file)) == sizeof(dat_file) &&
+        file_write(&file, &dat_buffer, sizeof(dat_buffer)) == sizeof(dat_buffer))
+    {
+        file_saved = true;
+    }
+
+    file_close(&file);
+
+    dat_crc = 0;
+    if (file_saved)
+    {
+        dat_sector_crc_update();
+    }
+
+    return file_saved;
+}
+
+static u32 dat_journal_block_crc(DAT_JOURNAL_BLOCK *block)
+{
+    crc_reset();
+    crc_calc(block, sizeof(DAT_JOURNAL_BLOCK) - sizeof(block->crc));
+    return crc_get();
+}
+
+static bool dat_journal_replay(FIL *file)
+{
+    // Apply all blocks until the first invalid one (e.g. due to power loss)
+    DAT_JOURNAL_BLOCK block;
+    bool applied = false;
+    while (file_read(file, &block, sizeof(block)) == sizeof(block) &&
+           block.size <= sizeof(block.data) &&
+           dat_journal_block_crc(&block) == block.crc)
+    {
+        for (u16 i=0; i + sizeof(DAT_JOURNAL_RECORD) <= block.size; )
+        {
+            DAT_JOURNAL_RECORD record;
+            memcpy(&record, block.data + i, sizeof(record));
+            i += sizeof(record);
+
+            u16 len = record.len & ~DAT_JOURNAL_FILL;
+            if (record.pos + len > sizeof(dat_buffer))
+            {
+                break;
+            }
+
+            if (record.len & DAT_JOURNAL_FILL)
+            {
+                memset(dat_buffer + record.pos, 0xff, len);
+            }
+            else
+            {
+                if (i + len > block.size)
+                {
+                    break;
+                }
+
+                memcpy(dat_buffer + record.pos, block.data + i, len);
+                i += len;
+            }
+        }
+
+        applied = true;
+    }
+
+    return applied;
+}
+
+static void dat_journal_compact(void)
+{
+    FIL file;
+    if (f_open(&file, DAT_JOURNAL_FILENAME, FA_READ) != FR_OK)
+    {
+        return;
+    }
+
+    bool applied = dat_journal_replay(&file);
+    file_close(&file);
+
+    // Replaying the journal again is harmless if this fails
+    if (!applied || save_dat())
+    {
+        dbg("Journal " DAT_JOURNAL_FILENAME " compacted");
+        file_delete(DAT_JOURNAL_FILENAME);
+    }
+}
+
+// A journal without a valid DAT file belongs to another file and must not
+// be applied to a newly created one
+static void dat_journal_discard(void)
+{
+    FILINFO info;
+    if (f_stat(DAT_JOURNAL_FILENAME, &info) == FR_OK)
+    {
+        wrn("Discarding " DAT_JOURNAL_FILENAME);
+        file_delete(DAT_JOURNAL_FILENAME);
+    }
+}
+
 static bool load_dat(void)
 {
+    // dat_buffer still holds the file content after a menu restart (or if it
+    // has not been used since it was loaded) unless the CRC differs
+    u32 expected_crc = menu_signature() ? *MENU_DAT_CRC_BUF : dat_crc;
+
     bool result = true;
     FIL file;
     if (!file_open(&file, DAT_FILENAME, FA_READ) ||
         file_read(&file, &dat_file, sizeof(dat_file)) != sizeof(dat_file) ||
-        file_read(&file, dat_buffer, sizeof(dat_buffer)) != sizeof(dat_buffer) ||
-        memcmp(DAT_SIGNATURE, dat_file.signature, sizeof(dat_file.signature)) != 0)
+        memcmp(DAT_SIGNATURE, dat_file.signature, sizeof(dat_file.signature)) != 0 ||
+        (!dat_buffer_loaded(expected_crc) &&
+         file_read(&file, dat_buffer, sizeof(dat_buffer)) != sizeof(dat_buffer)))
     {
         wrn(DAT_FILENAME " file not found or invalid");
         memset(&dat_file, 0, sizeof(dat_file));
@@ -473,6 +908,18 @@ static bool load_dat(void)
     }
 
     file_close(&file);
+
+    dat_crc = 0;
+    if (result)
+    {
+        dat_sector_crc_update();
+        dat_journal_compact();
+    }
+    else
+    {
+        dat_journal_discard();
+    }
+
     return result;
 }
 
@@ -510,28 +957,6 @@ static bool auto_boot(void)
     return result;
 }
 
-static bool save_dat(void)
-{
-    dbg("Saving " DAT_FILENAME " file");
-
-    FIL file;
-    if (!file_open(&file, DAT_FILENAME, FA_WRITE|FA_CREATE_ALWAYS))
-    {
-        wrn("Could not open " DAT_FILENAME " for writing");
-        return false;
-    }
-
-    bool file_saved = false;
-    if (file_write(&file, &dat_file, sizeof(dat_file)) == sizeof(dat_file) &&
-        file_write(&file, &dat_buffer, sizeof(dat_buffer)) == sizeof(dat_buffer))
-    {
-        file_saved = true;
-    }
-
-    file_close(&file);
-    return file_saved;
-}
-
 static inline bool persist_basic_selection(void)
 {
     return (dat_file.flags & DAT_FLAG_PERSIST_BASIC) != 0;
@@ -754,8 +1179,9 @@ static bool c64_set_mode(void)
                 break;
             }
 
-            u32 flash_hash = crt_calc_flash_crc(dat_file.crt.banks);
-            if (flash_hash != dat_file.crt.flash_hash &&
+            // Skip the check if the flash was just programmed and verified
+            if (crt_flash_hash != dat_file.crt.flash_hash &&
+                crt_calc_flash_crc(dat_file.crt.banks) != dat_file.crt.flash_hash &&
                 !(dat_file.crt.flags & CRT_FLAG_UPDATED))
             {
                 break;
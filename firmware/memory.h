@@ -20,12 +20,40 @@
 
 #define MENU_RAM_SIGNATURE  "KungFu:Menu"
 #define MEMU_SIGNATURE_BUF  ((u32 *)scratch_buf)
+#define MENU_DAT_CRC_BUF    ((u32 *)scratch_buf + 3)
 
-// 64kB data buffer
-__attribute__((__section__(".sram"))) static u8 dat_buffer[64*1024];
+// Last sector of scratch_buf is used for SD card writes in disk and EAPI mode
+#define SDIO_BOUNCE_BUF     ((u8 *)scratch_buf + sizeof(scratch_buf) - 512)
 
-// 16kB scratch buffer
-__attribute__((__section__(".sram"))) static char scratch_buf[16*1024];
+// SD card read-ahead cache in menu mode (after KFF RAM and loading text).
+// Filled without DMA as dat_buffer must be kept and scratch_buf is in use
+#define MENU_READ_AHEAD_BUF     (crt_ram_buf + 0x200)
+#define MENU_READ_AHEAD_SIZE    (8*1024)
+
+// D64 track cache in menu mode (after the read-ahead cache)
+#define MENU_TRACK_CACHE_BUF    (MENU_READ_AHEAD_BUF + MENU_READ_AHEAD_SIZE)
+#define MENU_TRACK_CACHE_SIZE   (16*1024)
+
+// SD card directory index in menu mode (rest of the CRT RAM buffer)
+#define MENU_DIR_INDEX_BUF      (MENU_TRACK_CACHE_BUF + MENU_TRACK_CACHE_SIZE)
+#define MENU_DIR_INDEX_SIZE     (32*1024 - 0x200 - MENU_READ_AHEAD_SIZE - \
+                                 MENU_TRACK_CACHE_SIZE)
+
+// SD card read-ahead cache in disk mode (before the bounce buffer)
+#define DISK_READ_AHEAD_SIZE    (4*1024)
+#define DISK_READ_AHEAD_BUF     (SDIO_BOUNCE_BUF - DISK_READ_AHEAD_SIZE)
+
+// D64 track cache in disk mode (between menu signature and read-ahead cache)
+#define DISK_TRACK_CACHE_BUF    ((u8 *)scratch_buf + 256)
+#define DISK_TRACK_CACHE_SIZE   (sizeof(scratch_buf) - 256 - \
+                                 DISK_READ_AHEAD_SIZE - 512)
+
+// 64kB data buffer. Aligned for SDIO DMA bursts
+__attribute__((__section__(".sram"), aligned(16))) static u8 dat_buffer[64*1024];
+
+// 16kB scratch buffer. Placed in SRAM2 as the disk track cache and the
+// bounce buffer are written by DMA while the C64 bus handler is running
+__attribute__((__section__(".sram2"), aligned(16))) static char scratch_buf[16*1024];
 
 // 32kB buffer for CRT RAM
 __attribute__((__section__(".uninit"))) static u8 crt_ram_buf[32*1024];
@@ -34,6 +34,8 @@
 
 static void menu_loop(void)
 {
+    disk_set_read_ahead(MENU_READ_AHEAD_BUF, MENU_READ_AHEAD_SIZE);
+    d64_set_track_cache(MENU_TRACK_CACHE_BUF, MENU_TRACK_CACHE_SIZE);
     menu = sd_menu_init();
     char *search = sd_state.search;
 
@@ -140,6 +142,10 @@ static void menu_loop(void)
     {
         save_dat();
     }
+
+    // CRT RAM buffer may be used by the cartridge
+    disk_set_read_ahead(NULL, 0);
+    d64_set_track_cache(NULL, 0);
 }
 
 static void fail_to_read_sd(void)
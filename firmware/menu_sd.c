@@ -63,6 +63,432 @@ static void sd_format_element(char *buffer, FILINFO *info)
     }
 }
 
+static u32 sd_index_hash(const char *str, u32 hash)
+{
+    // FNV-1a
+    while (*str)
+    {
+        hash ^= (u8)*str++;
+        hash *= 16777619;
+    }
+
+    return hash;
+}
+
+static u32 sd_sort_hash(FILINFO *info, u32 hash)
+{
+    hash = sd_index_hash(info->fname, hash);
+    hash = (hash ^ info->fattrib) * 16777619;
+    return (hash ^ info->fsize) * 16777619;
+}
+
+static int sd_sort_compare(SD_SORT_ENTRY *a, SD_SORT_ENTRY *b)
+{
+    // Directories first
+    if ((a->fattrib ^ b->fattrib) & AM_DIR)
+    {
+        return (a->fattrib & AM_DIR) ? -1 : 1;
+    }
+
+    const char *name_a = a->fname;
+    const char *name_b = b->fname;
+    while (true)
+    {
+        int c_a = ff_wtoupper((u8)*name_a++);
+        int c_b = ff_wtoupper((u8)*name_b++);
+        if (c_a != c_b || !c_a)
+        {
+            return c_a - c_b;
+        }
+    }
+}
+
+static bool sd_sort_read_entry(FIL *file, u32 offset, u32 entry,
+                               SD_SORT_ENTRY *sort_entry)
+{
+    return file_seek(file, offset + entry * sizeof(SD_SORT_ENTRY)) &&
+           file_read(file, sort_entry, sizeof(SD_SORT_ENTRY)) ==
+           sizeof(SD_SORT_ENTRY);
+}
+
+static bool sd_sort_key(SD_SORT_HEADER *key)
+{
+    memset(key, 0, sizeof(SD_SORT_HEADER));
+    memcpy(key->signature, SD_SORT_SIGNATURE, sizeof(key->signature));
+
+    // The root directory doesn't have a modification time
+    FILINFO file_info;
+    if (dat_file.path[1] && file_stat(dat_file.path, &file_info))
+    {
+        key->fdate = file_info.fdate;
+        key->ftime = file_info.ftime;
+    }
+
+    // The modification time is not always updated so include all entries
+    DIR_t dir;
+    if (!dir_open(&dir, NULL))
+    {
+        return false;
+    }
+
+    key->hash = 2166136261;
+    while (true)
+    {
+        if (!dir_read(&dir, &file_info))
+        {
+            return false;
+        }
+
+        if (!file_info.fname[0])
+        {
+            break;
+        }
+
+        key->hash = sd_sort_hash(&file_info, key->hash);
+        key->count++;
+    }
+
+    dir_close(&dir);
+    return true;
+}
+
+static bool sd_sort_write_run(FIL *file, SD_SORT_ENTRY *entries, u32 count)
+{
+    u8 order[SD_SORT_RUN_ENTRIES];
+    for (u32 i=0; i<count; i++)
+    {
+        // Insertion sort
+        u32 j = i;
+        while (j && sd_sort_compare(entries + order[j-1], entries + i) > 0)
+        {
+            order[j] = order[j-1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    for (u32 i=0; i<count; i++)
+    {
+        if (file_write(file, entries + order[i], sizeof(SD_SORT_ENTRY)) !=
+            sizeof(SD_SORT_ENTRY))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool sd_sort_merge(FIL *src, u32 src_offset, FIL *dst, u32 start,
+                          u32 end, u32 run_length)
+{
+    // Merge up to SD_SORT_RUN_ENTRIES runs with the head of each in memory
+    SD_SORT_ENTRY *heads = (SD_SORT_ENTRY *)scratch_buf;
+    u32 next[SD_SORT_RUN_ENTRIES];
+    u32 run_end[SD_SORT_RUN_ENTRIES];
+
+    u32 runs = 0;
+    for (u32 run=start; run<end; run += run_length)
+    {
+        next[runs] = run;
+        run_end[runs] = run + run_length < end ? run + run_length : end;
+        if (!sd_sort_read_entry(src, src_offset, next[runs]++, heads + runs))
+        {
+            return false;
+        }
+        runs++;
+    }
+
+    for (u32 count=start; count<end; count++)
+    {
+        u32 min_run = SD_SORT_RUN_ENTRIES;
+        for (u32 run=0; run<runs; run++)
+        {
+            if (next[run] <= run_end[run] && (min_run == SD_SORT_RUN_ENTRIES ||
+                sd_sort_compare(heads + run, heads + min_run) < 0))
+            {
+                min_run = run;
+            }
+        }
+
+        if (file_write(dst, heads + min_run, sizeof(SD_SORT_ENTRY)) !=
+            sizeof(SD_SORT_ENTRY))
+        {
+            return false;
+        }
+
+        if (next[min_run] < run_end[min_run])
+        {
+            if (!sd_sort_read_entry(src, src_offset, next[min_run],
+                                    heads + min_run))
+            {
+                return false;
+            }
+        }
+        next[min_run]++;
+    }
+
+    return true;
+}
+
+static bool sd_sort_build(SD_SORT_HEADER *key, FIL *files)
+{
+    // Count the merge passes so that the last pass will write the cache file
+    const u32 run_length = SD_SORT_RUN_ENTRIES;
+    u32 passes = 0;
+    for (u32 length = run_length; length < key->count; length *= run_length)
+    {
+        passes++;
+    }
+
+    const u32 offset[2] = {sizeof(SD_SORT_HEADER), 0};
+    u32 dst = passes & 1;
+
+    // Sort runs of scratch_buf size
+    DIR_t dir;
+    if (!dir_open(&dir, NULL))
+    {
+        return false;
+    }
+
+    SD_SORT_ENTRY *entries = (SD_SORT_ENTRY *)scratch_buf;
+    u32 total = 0;
+    bool dir_end = false;
+    while (!dir_end)
+    {
+        u32 count = 0;
+        while (count < run_length)
+        {
+            FILINFO file_info;
+            if (!dir_read(&dir, &file_info))
+            {
+                return false;
+            }
+
+            if (!file_info.fname[0])
+            {
+                dir_end = true;
+                break;
+            }
+
+            SD_SORT_ENTRY *entry = entries + count++;
+            entry->fsize = file_info.fsize;
+            entry->fattrib = file_info.fattrib;
+            strcpy(entry->fname, file_info.fname);
+        }
+
+        if (!sd_sort_write_run(files + dst, entries, count))
+        {
+            return false;
+        }
+        total += count;
+    }
+    dir_close(&dir);
+
+    if (total != key->count)
+    {
+        wrn("Directory changed while sorting");
+        return false;
+    }
+
+    // Merge runs until there is only one left
+    for (u32 length = run_length; length < total; length *= run_length)
+    {
+        u32 src = dst;
+        dst ^= 1;
+
+        if (!file_seek(files + dst, offset[dst]))
+        {
+            return false;
+        }
+
+        for (u32 start=0; start<total; start += length * run_length)
+        {
+            u32 end = start + length * run_length;
+            if (!sd_sort_merge(files + src, offset[src], files + dst, start,
+                               end < total ? end : total, length))
+            {
+                return false;
+            }
+        }
+    }
+
+    return file_seek(files, 0) &&
+           file_write(files, key, sizeof(SD_SORT_HEADER)) ==
+           sizeof(SD_SORT_HEADER);
+}
+
+static bool sd_sort_create(SD_SORT_HEADER *key)
+{
+    // External merge sort using the cache file and a temporary file
+    FIL files[2];
+    if (!file_open(files, SD_SORT_FILENAME, FA_READ|FA_WRITE|FA_CREATE_ALWAYS))
+    {
+        return false;
+    }
+
+    // Header is written when done
+    SD_SORT_HEADER header;
+    memset(&header, 0, sizeof(header));
+
+    bool sorted = false;
+    if (file_write(files, &header, sizeof(header)) == sizeof(header) &&
+        file_open(files + 1, SD_SORT_TMP_FILENAME,
+                  FA_READ|FA_WRITE|FA_CREATE_ALWAYS))
+    {
+        sorted = sd_sort_build(key, files);
+        file_close(files + 1);
+        file_delete(SD_SORT_TMP_FILENAME);
+    }
+
+    if (!file_close(files) || !sorted)
+    {
+        wrn("Failed to sort directory");
+        file_delete(SD_SORT_FILENAME);
+        return false;
+    }
+
+    return true;
+}
+
+static SD_SORT_CHECKED * sd_sort_checked_find(u32 dir_hash)
+{
+    // Cache files are hidden so creating them doesn't change any listing
+    u32 changes = fs_changes - sd_sort_changes;
+    for (u8 i=0; i<SD_SORT_CHECKED_DIRS; i++)
+    {
+        SD_SORT_CHECKED *checked = sd_sort_checked + i;
+        if (checked->dir_hash == dir_hash && checked->fs_changes == changes)
+        {
+            return checked;
+        }
+    }
+
+    return NULL;
+}
+
+static void sd_sort_checked_add(u32 dir_hash, u32 count, bool sorted)
+{
+    SD_SORT_CHECKED *checked = sd_sort_checked_find(dir_hash);
+    if (!checked)
+    {
+        checked = sd_sort_checked + sd_sort_checked_next++;
+        sd_sort_checked_next %= SD_SORT_CHECKED_DIRS;
+    }
+
+    checked->dir_hash = dir_hash;
+    checked->fs_changes = fs_changes - sd_sort_changes;
+    checked->count = count;
+    checked->sorted = sorted;
+}
+
+static void sd_sort_open(SD_STATE *state)
+{
+    if (state->sorted)
+    {
+        file_close(&state->sort_file);
+        state->sorted = false;
+    }
+
+    if (!(dat_file.flags & DAT_FLAG_SORT_DIR) || state->search[0])
+    {
+        return;
+    }
+
+    // Skip the directory scan if already checked and nothing has changed
+    FIL *file = &state->sort_file;
+    u32 dir_hash = sd_index_hash(dat_file.path, 2166136261);
+    SD_SORT_CHECKED *checked = sd_sort_checked_find(dir_hash);
+    if (checked)
+    {
+        if (!checked->sorted)
+        {
+            return; // Don't retry before the file system changes
+        }
+
+        if (f_open(file, SD_SORT_FILENAME, FA_READ) == FR_OK)
+        {
+            state->sorted = true;
+            state->sort_count = checked->count;
+            return;
+        }
+    }
+
+    SD_SORT_HEADER key;
+    if (!sd_sort_key(&key))
+    {
+        return;
+    }
+
+    // Use cache file if it is up to date
+    if (f_open(file, SD_SORT_FILENAME, FA_READ) == FR_OK)
+    {
+        SD_SORT_HEADER header;
+        if (file_read(file, &header, sizeof(header)) == sizeof(header) &&
+            memcmp(&header, &key, sizeof(header)) == 0)
+        {
+            state->sorted = true;
+            state->sort_count = key.count;
+            sd_sort_checked_add(dir_hash, key.count, true);
+            return;
+        }
+
+        file_close(file);
+    }
+
+    dbg("Sorting %u entries in %s", key.count, dat_file.path);
+
+    // Writes are done with the C64 interface active
+    u32 changes = fs_changes;
+    sdio_set_bounce_buffer(SDIO_BOUNCE_BUF);
+    bool sorted = sd_sort_create(&key);
+    sdio_set_bounce_buffer(NULL);
+    sd_sort_changes += fs_changes - changes;
+
+    if (sorted && file_open(file, SD_SORT_FILENAME, FA_READ))
+    {
+        state->sorted = true;
+        state->sort_count = key.count;
+    }
+
+    sd_sort_checked_add(dir_hash, key.count, state->sorted);
+}
+
+static bool sd_dir_read(SD_STATE *state, SD_DIR_POS *pos, FILINFO *file_info)
+{
+    if (!state->sorted)
+    {
+        return dir_read(&pos->dir, file_info);
+    }
+
+    if (pos->entry >= state->sort_count)
+    {
+        file_info->fname[0] = 0;
+        return true;
+    }
+
+    SD_SORT_ENTRY entry;
+    if (!sd_sort_read_entry(&state->sort_file, sizeof(SD_SORT_HEADER),
+                            pos->entry++, &entry))
+    {
+        return false;
+    }
+
+    file_info->fsize = entry.fsize;
+    file_info->fattrib = entry.fattrib;
+    file_info->altname[0] = 0;
+    strcpy(file_info->fname, entry.fname);
+    return true;
+}
+
+static void sd_dir_close(SD_STATE *state, SD_DIR_POS *pos)
+{
+    if (!state->sorted)
+    {
+        dir_close(&pos->dir);
+    }
+}
+
 static void sd_send_not_found(SD_STATE *state)
 {
     to_petscii_pad(scratch_buf, " no files found", ELEMENT_LENGTH);
@@ -93,7 +519,7 @@ static u8 sd_send_page(SD_STATE *state, u8 selected_element)
         }
         else
         {
-            if (!dir_read(&state->end_page, &file_info))
+            if (!sd_dir_read(state, &state->end_page, &file_info))
             {
                 file_info.fname[0] = 0;
             }
@@ -105,7 +531,7 @@ static u8 sd_send_page(SD_STATE *state, u8 selected_element)
             else
             {
                 // End of dir
-                dir_close(&state->end_page);
+                sd_dir_close(state, &state->end_page);
                 state->dir_end = true;
 
                 if (send_not_found)
@@ -140,16 +566,87 @@ static void sd_dir_open(SD_STATE *state)
         state->search[search_len + 1] = 0;
     }
 
-    if (!dir_open(&state->start_page, state->search))
+    if (!dir_open(&state->start_page.dir, state->search))
     {
         fail_to_read_sd();
     }
+    state->start_page.entry = 0;
 
     state->end_page = state->start_page;
     state->page_no = 0;
     state->dir_end = false;
 }
 
+static void sd_index_add(SD_STATE *state)
+{
+    u16 page_no = state->page_no;
+    if (!state->sorted && page_no == SD_INDEX->pages &&
+        page_no < SD_DIR_INDEX_PAGES)
+    {
+        SD_INDEX->page[SD_INDEX->pages++] = state->start_page.dir;
+    }
+}
+
+static void sd_index_open(SD_STATE *state)
+{
+    u32 dir_hash = sd_index_hash(dat_file.path, 2166136261);
+    dir_hash = sd_index_hash(state->search, dir_hash);
+
+    if (SD_INDEX->dir_hash != dir_hash || SD_INDEX->fs_changes != fs_changes)
+    {
+        SD_INDEX->dir_hash = dir_hash;
+        SD_INDEX->fs_changes = fs_changes;
+        SD_INDEX->selected_hash = 0;
+        SD_INDEX->selected_page = 0;
+        SD_INDEX->pages = 0;
+    }
+
+    sd_index_add(state);
+}
+
+static bool sd_index_seek(SD_STATE *state, u16 page_no)
+{
+    if (state->sorted)
+    {
+        // Position of sorted entries is known
+        state->start_page.entry = page_no * MAX_ELEMENTS_PAGE;
+        if (page_no && !state->in_root)
+        {
+            state->start_page.entry--;
+        }
+    }
+    else if (page_no < SD_INDEX->pages && SD_INDEX->fs_changes == fs_changes)
+    {
+        state->start_page.dir = SD_INDEX->page[page_no];
+    }
+    else
+    {
+        return false;
+    }
+
+    state->end_page = state->start_page;
+    state->page_no = page_no;
+    state->dir_end = false;
+    return true;
+}
+
+static void sd_index_select(u16 page_no, const char *filename)
+{
+    SD_INDEX->selected_hash = sd_index_hash(filename, 2166136261);
+    SD_INDEX->selected_page = page_no;
+}
+
+static bool sd_index_seek_selected(SD_STATE *state, const char *filename)
+{
+    if (!SD_INDEX->selected_page ||
+        SD_INDEX->selected_hash != sd_index_hash(filename, 2166136261))
+    {
+        return false;
+    }
+
+    return sd_index_seek(state, SD_INDEX->selected_page);
+}
+
 static void sd_send_prg_message(const char *message)
 {
     c64_send_prg_message(message);
@@ -292,6 +789,8 @@ static u8 sd_handle_dir(SD_STATE *state)
     sd_dir_open(state);
 
     dir_current(dat_file.path, sizeof(dat_file.path));
+    sd_sort_open(state);
+    sd_index_open(state);
     state->in_root = format_path(scratch_buf, false);
     scratch_buf[0] = state->search[0] ? SEARCH_SUPPORTED : CLEAR_SEARCH;
     dbg("Reading path %s", dat_file.path);
@@ -303,7 +802,9 @@ static u8 sd_handle_dir(SD_STATE *state)
 
     if (dat_file.file[0])
     {
-        DIR_t first_page = state->start_page;
+        // Start at the page where the file was last selected (if known)
+        SD_DIR_POS first_page = state->start_page;
+        bool seek_selected = sd_index_seek_selected(state, dat_file.file);
         while (true)
         {
             u8 element = 0;
@@ -314,7 +815,7 @@ static u8 sd_handle_dir(SD_STATE *state)
 
             for (; element<MAX_ELEMENTS_PAGE; element++)
             {
-                if (!dir_read(&state->end_page, &file_info))
+                if (!sd_dir_read(state, &state->end_page, &file_info))
                 {
                     file_info.fname[0] = 0;
                 }
@@ -335,9 +836,20 @@ static u8 sd_handle_dir(SD_STATE *state)
             {
                 state->end_page = state->start_page;
                 selected_element = element;
+                sd_index_select(state->page_no, dat_file.file);
                 break;
             }
 
+            if (seek_selected)
+            {
+                // Not on the expected page. Search from the beginning
+                seek_selected = false;
+                state->start_page = first_page;
+                state->end_page = first_page;
+                state->page_no = 0;
+                continue;
+            }
+
             if (!file_info.fname[0])
             {
                 state->start_page = first_page;
@@ -348,6 +860,7 @@ static u8 sd_handle_dir(SD_STATE *state)
 
             state->start_page = state->end_page;
             state->page_no++;
+            sd_index_add(state);
         }
     }
 
@@ -415,12 +928,13 @@ static u8 sd_handle_dir_next_page(SD_STATE *state)
 {
     if (!state->dir_end)
     {
-        DIR_t start = state->end_page;
+        SD_DIR_POS start = state->end_page;
         state->page_no++;
 
         if (sd_send_page(state, MAX_ELEMENTS_PAGE) > 0)
         {
             state->start_page = start;
+            sd_index_add(state);
         }
         else
         {
@@ -440,6 +954,12 @@ static u8 sd_handle_dir_prev_page(SD_STATE *state)
     if (state->page_no)
     {
         u16 target_page = state->page_no-1;
+        if (sd_index_seek(state, target_page))
+        {
+            sd_send_page(state, MAX_ELEMENTS_PAGE);
+            return CMD_READ_DIR_PAGE;
+        }
+
         bool not_found = false;
 
         sd_dir_open(state);
@@ -450,7 +970,7 @@ static u8 sd_handle_dir_prev_page(SD_STATE *state)
         while (elements_to_skip--)
         {
             FILINFO file_info;
-            if (!dir_read(&state->end_page, &file_info))
+            if (!sd_dir_read(state, &state->end_page, &file_info))
             {
                 file_info.fname[0] = 0;
             }
@@ -819,10 +1339,10 @@ static u8 sd_handle_select(SD_STATE *state, u8 flags, u8 element)
     }
 
     FILINFO file_info;
-    DIR_t dir = state->start_page;
+    SD_DIR_POS pos = state->start_page;
     for (u8 i=0; i<=element_no; i++)
     {
-        if (!dir_read(&dir, &file_info))
+        if (!sd_dir_read(state, &pos, &file_info))
         {
             fail_to_read_sd();
         }
@@ -833,7 +1353,7 @@ static u8 sd_handle_select(SD_STATE *state, u8 flags, u8 element)
         }
     }
 
-    dir_close(&dir);
+    sd_dir_close(state, &pos);
 
     if (file_info.fname[0] == 0)
     {
@@ -844,6 +1364,7 @@ static u8 sd_handle_select(SD_STATE *state, u8 flags, u8 element)
 
     u8 file_type = get_file_type(&file_info);
     strcpy(dat_file.file, file_info.fname);
+    sd_index_select(state->page_no, dat_file.file);
 
     if (flags & SELECT_FLAG_OPTIONS)
     {
@@ -904,6 +1425,7 @@ static const MENU *sd_menu_init(void)
     chdir_last();
     sd_state.page_no = 0;
     sd_state.dir_end = true;
+    SD_INDEX->pages = 0;
 
     return &sd_menu;
 }
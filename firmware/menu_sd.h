@@ -18,16 +18,83 @@
  * 3. This notice may not be removed or altered from any source distribution.
  */
 
+typedef struct
+{
+    DIR_t dir;
+    u32 entry;          // Used if directory is sorted
+} SD_DIR_POS;
+
 typedef struct
 {
     bool in_root;
     bool dir_end;
+    bool sorted;
 
-    DIR_t start_page;
-    DIR_t end_page;
+    SD_DIR_POS start_page;
+    SD_DIR_POS end_page;
     u16 page_no;
 
+    FIL sort_file;
+    u32 sort_count;
+
     char search[SEARCH_LENGTH+2];
 } SD_STATE;
 
 static SD_STATE sd_state;
+
+typedef struct
+{
+    u32 dir_hash;       // Hash of path and search pattern
+    u32 fs_changes;     // Index is invalid if the file system has changed
+    u32 selected_hash;  // Hash of last selected file
+    u16 selected_page;  // Page of last selected file
+    u16 pages;
+    DIR_t page[];       // Start of each page
+} SD_DIR_INDEX;
+
+#define SD_DIR_INDEX_PAGES \
+    ((MENU_DIR_INDEX_SIZE - sizeof(SD_DIR_INDEX)) / sizeof(DIR_t))
+
+#define SD_INDEX ((SD_DIR_INDEX *)MENU_DIR_INDEX_BUF)
+
+typedef struct
+{
+    char signature[8];  // SD_SORT_SIGNATURE
+    u16 fdate;          // Modification time of directory
+    u16 ftime;
+    u32 count;          // Number of entries
+    u32 hash;           // Hash of all entries
+} SD_SORT_HEADER;
+
+typedef struct
+{
+    u32 fsize;
+    u8 fattrib;
+    char fname[FF_LFN_BUF + 1];
+} SD_SORT_ENTRY;
+
+typedef struct
+{
+    u32 dir_hash;       // Hash of path
+    u32 fs_changes;     // Result is invalid if the file system has changed
+    u32 count;          // Number of sorted entries
+    bool sorted;        // Sorting failed if false
+} SD_SORT_CHECKED;
+
+// Directories checked against the cache file since start-up. Only the
+// first visit needs to scan the directory
+#define SD_SORT_CHECKED_DIRS    16
+
+static SD_SORT_CHECKED sd_sort_checked[SD_SORT_CHECKED_DIRS];
+static u8 sd_sort_checked_next;
+static u32 sd_sort_changes; // File system changes made by sorting
+
+// Sorted directory listing is cached in a hidden file in each directory
+#define SD_SORT_FILENAME        ".kffsort"
+#define SD_SORT_TMP_FILENAME    ".kffsort.tmp"
+#define SD_SORT_SIGNATURE       "KFF:Sort"
+
+// Entries sorted in memory and max runs merged at a time (the last sector of
+// scratch_buf is used as SDIO bounce buffer)
+#define SD_SORT_RUN_ENTRIES \
+    ((sizeof(scratch_buf) - 512) / sizeof(SD_SORT_ENTRY))
@@ -70,6 +70,28 @@ static u8 settings_autostart_change(OPTIONS_STATE *state, OPTIONS_ELEMENT *eleme
     return settings_refresh(element, settings_autostart_text());
 }
 
+static const char * settings_sort_text(void)
+{
+    sprint(scratch_buf, "Sort directories: %s",
+           (settings_flags & DAT_FLAG_SORT_DIR) ? "yes" : "no");
+
+    return scratch_buf;
+}
+
+static u8 settings_sort_change(OPTIONS_STATE *state, OPTIONS_ELEMENT *element, u8 flags)
+{
+    if (settings_flags & DAT_FLAG_SORT_DIR)
+    {
+        settings_flags &= ~DAT_FLAG_SORT_DIR;
+    }
+    else
+    {
+        settings_flags |= DAT_FLAG_SORT_DIR;
+    }
+
+    return settings_refresh(element, settings_sort_text());
+}
+
 static const char * settings_device_text(void)
 {
     sprint(scratch_buf, "Disk device number: %u", get_device_number(settings_flags));
@@ -103,6 +125,7 @@ static u8 handle_settings(void)
     options_add_text_element(options, settings_basic_change, settings_basic_text());
     options_add_text_element(options, settings_autostart_change, settings_autostart_text());
     options_add_text_element(options, settings_device_change, settings_device_text());
+    options_add_text_element(options, settings_sort_change, settings_sort_text());
     options_add_text_element(options, settings_save, "Save");
     options_add_dir(options, "Cancel");
     return handle_options();
@@ -23,6 +23,9 @@
 static inline void set_menu_signature(void)
 {
     memcpy(MEMU_SIGNATURE_BUF, MENU_RAM_SIGNATURE, sizeof(MENU_RAM_SIGNATURE));
+
+    // Allows load_dat() to skip reading dat_buffer if it is unchanged
+    *MENU_DAT_CRC_BUF = dat_crc;
 }
 
 static inline bool menu_signature(void)
@@ -221,6 +224,113 @@ static void c64_diag_handler(void)
     }
 }
 
+/*************************************************
+* C64 bus handler statistics
+*************************************************/
+#if BUS_STATS
+#define BUS_STATS_SIGNATURE     0x53554221  // "!BUS"
+#define BUS_STATS_BUCKET_SIZE   8           // Cycles per histogram bucket
+#define BUS_STATS_BUCKETS       32
+
+typedef struct
+{
+    u32 histogram[BUS_STATS_BUCKETS];
+    u32 max;
+    u32 deadline;   // Deadline of the max cycle
+    u32 misses;     // Finished after the deadline
+} BUS_PATH_STATS;
+
+typedef struct
+{
+    u32 signature;
+    bool enabled;
+    bool ntsc;
+    u16 cartridge_type;
+    BUS_PATH_STATS path[BUS_STATS_PATHS];
+} BUS_STATS_DATA;
+
+// Placed in CCM RAM and kept across restarts to allow the diagnostic to
+// show the statistics of the last cartridge
+__attribute__((__section__(".uninit"))) static BUS_STATS_DATA bus_stats;
+
+FORCE_INLINE void c64_bus_stats_add(u32 path, u32 deadline)
+{
+    if (bus_stats.enabled)
+    {
+        u32 cycles = DWT->CYCCNT;
+        BUS_PATH_STATS *stats = &bus_stats.path[path];
+
+        u32 bucket = cycles / BUS_STATS_BUCKET_SIZE;
+        if (bucket >= BUS_STATS_BUCKETS)
+        {
+            bucket = BUS_STATS_BUCKETS - 1;
+        }
+        stats->histogram[bucket]++;
+
+        if (cycles > stats->max)
+        {
+            stats->max = cycles;
+            stats->deadline = deadline;
+        }
+
+        if (cycles > deadline)
+        {
+            stats->misses++;
+        }
+    }
+}
+
+static void c64_bus_stats_start(u32 cartridge_type)
+{
+    memset(&bus_stats, 0, sizeof(bus_stats));
+    bus_stats.signature = BUS_STATS_SIGNATURE;
+    bus_stats.ntsc = c64_is_ntsc();
+    bus_stats.cartridge_type = cartridge_type;
+    bus_stats.enabled = true;
+}
+
+static void c64_bus_stats_stop(void)
+{
+    bus_stats.enabled = false;
+}
+
+static inline bool c64_bus_stats_valid(void)
+{
+    return bus_stats.signature == BUS_STATS_SIGNATURE;
+}
+
+// Returns the upper bound of the bucket containing the percentile
+static u32 c64_bus_stats_percentile(BUS_PATH_STATS *stats, u32 permille)
+{
+    u32 total = 0;
+    for (u32 i = 0; i < BUS_STATS_BUCKETS; i++)
+    {
+        total += stats->histogram[i];
+    }
+
+    if (!total)
+    {
+        return 0;
+    }
+
+    u64 limit = (u64)total * permille;
+    u64 count = 0;
+    for (u32 i = 0; i < BUS_STATS_BUCKETS; i++)
+    {
+        count += stats->histogram[i];
+        if (count * 1000 >= limit)
+        {
+            return (i + 1) * BUS_STATS_BUCKET_SIZE - 1;
+        }
+    }
+
+    return 0;
+}
+#else
+static inline void c64_bus_stats_start(u32 cartridge_type) {}
+static inline void c64_bus_stats_stop(void) {}
+#endif
+
 /*************************************************
 * C64 interface status
 *************************************************/
@@ -229,13 +339,13 @@ static void c64_interface_enable_no_check(void)
     s8 phi2_offset = dat_file.phi2_offset;
 
     // Limit offset
-    if (phi2_offset > 20)
+    if (phi2_offset > PHI2_OFFSET_MAX)
     {
-        phi2_offset = 20;
+        phi2_offset = PHI2_OFFSET_MAX;
     }
-    else if (phi2_offset < -20)
+    else if (phi2_offset < -PHI2_OFFSET_MAX)
     {
-        phi2_offset = -20;
+        phi2_offset = -PHI2_OFFSET_MAX;
     }
     dat_file.phi2_offset = phi2_offset;
 
@@ -439,4 +549,5 @@ static void c64_interface_config(void)
     c64_clock_config();
 
     button_config();
+    c64_bus_stats_stop();
 }
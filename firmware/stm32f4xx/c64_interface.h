@@ -117,6 +117,28 @@ FORCE_INLINE void wait_n_cycles(u32 n_cycles)
     /* Make cycles to wait negative to reduce code size */  \
     wait_n_cycles(cnt - until)
 
+/*************************************************
+* C64 bus handler statistics
+* Enable with -DBUS_STATS=1 to record the cycle each handler path finishes
+*************************************************/
+#ifndef BUS_STATS
+#define BUS_STATS 0
+#endif
+
+#define BUS_STATS_READ      0
+#define BUS_STATS_WRITE     1
+#define BUS_STATS_VIC       2
+#define BUS_STATS_PATHS     3
+
+#if BUS_STATS
+#define C64_BUS_STATS(path, deadline) c64_bus_stats_add(path, deadline)
+#else
+#define C64_BUS_STATS(path, deadline)
+#endif
+
+// Max phi2 offset in either direction
+#define PHI2_OFFSET_MAX     20
+
 // C64_BUS_HANDLER timing
 #define NTSC_PHI2_HIGH      98
 #define NTSC_PHI2_INT       (NTSC_PHI2_HIGH - 42)
@@ -132,6 +154,9 @@ FORCE_INLINE void wait_n_cycles(u32 n_cycles)
 #define C64_BUS_HANDLER_READ(name, read_handler)                                \
     C64_BUS_HANDLER_(name##_handler, read_handler, name##_write_handler)
 
+#define C64_BUS_HANDLER_WRITE(name, write_handler)                              \
+    C64_BUS_HANDLER_(name##_handler, name##_read_handler, write_handler)
+
 #define C64_BUS_HANDLER_(handler, read_handler, write_handler)                  \
 __attribute__((optimize("O2")))                                                 \
 static void handler(void)                                                       \
@@ -154,6 +179,7 @@ static void handler(void)
     {                                                                           \
         if (read_handler(control, addr))                                        \
         {                                                                       \
+            C64_BUS_STATS(BUS_STATS_READ, DWT->COMP1);                          \
             /* Wait for phi2 to go low */                                       \
             u32 phi2_low = DWT->COMP1;                                          \
             while (DWT->CYCCNT < phi2_low);                                     \
@@ -165,6 +191,7 @@ static void handler(void)
     {                                                                           \
         u32 data = C64_DATA_READ();                                             \
         write_handler(control, addr, data);                                     \
+        C64_BUS_STATS(BUS_STATS_WRITE, TIM1->CCR1);                             \
     }                                                                           \
 }
 
@@ -238,34 +265,48 @@ static void handler(void)
     timing##_VIC_DELAY_SHORT();
 
 #define C64_VIC_BUS_HANDLER(name)                                               \
-    C64_VIC_BUS_HANDLER_(name##_ntsc_handler, NTSC, name)                       \
-    C64_VIC_BUS_HANDLER_(name##_pal_handler, PAL, name)
+    C64_VIC_BUS_HANDLER_SHARED(name, name)
+
+// Use the VIC-II cycle handlers of vic_name
+#define C64_VIC_BUS_HANDLER_SHARED(name, vic_name)                              \
+    C64_VIC_BUS_HANDLER_(name##_ntsc_handler, NTSC, name, vic_name)             \
+    C64_VIC_BUS_HANDLER_(name##_pal_handler, PAL, name, vic_name)
 
-#define C64_VIC_BUS_HANDLER_(handler, timing, name)                             \
+#define C64_VIC_BUS_HANDLER_(handler, timing, name, vic_name)                   \
     C64_VIC_BUS_HANDLER_EX__(handler,                                           \
-                            C64_EARLY_CPU_VIC_HANDLER(name),                    \
-                            name##_vic_read_handler, name##_read_handler,       \
+                            C64_EARLY_CPU_VIC_HANDLER(vic_name),                \
+                            vic_name##_vic_read_handler, name##_read_handler,   \
                             timing##_WRITE_DELAY(), name##_write_handler,       \
-                            C64_EARLY_VIC_HANDLER(name, timing), timing)
+                            C64_EARLY_VIC_HANDLER(vic_name, timing), timing)
 
 #define C64_VIC_BUS_HANDLER_EX(name)                                            \
-    C64_VIC_BUS_HANDLER_EX_(name##_ntsc_handler, NTSC, name)                    \
-    C64_VIC_BUS_HANDLER_EX_(name##_pal_handler, PAL, name)
+    C64_VIC_BUS_HANDLER_EX_SHARED(name, name##_vic_read_handler,                \
+                                  name##_write_handler)
+
+#define C64_VIC_BUS_HANDLER_EX_SHARED(name, vic_read_handler, write_handler)    \
+    C64_VIC_BUS_HANDLER_EX_(name##_ntsc_handler, NTSC, name,                    \
+                            vic_read_handler, write_handler)                    \
+    C64_VIC_BUS_HANDLER_EX_(name##_pal_handler, PAL, name,                      \
+                            vic_read_handler, write_handler)
 
-#define C64_VIC_BUS_HANDLER_EX_(handler, timing, name)                          \
+#define C64_VIC_BUS_HANDLER_EX_(handler, timing, name,                          \
+                                vic_read_handler, write_handler)                \
     C64_VIC_BUS_HANDLER_EX__(handler, timing##_CPU_VIC_DELAY(),                 \
-                            name##_vic_read_handler, name##_read_handler,       \
-                            name##_early_write_handler(), name##_write_handler, \
+                            vic_read_handler, name##_read_handler,              \
+                            name##_early_write_handler(), write_handler,        \
                             timing##_VIC_DELAY(), timing)
 
 #define C64_C128_BUS_HANDLER(name)                                              \
-    C64_C128_BUS_HANDLER_(name##_ntsc_handler, NTSC, name)                      \
-    C64_C128_BUS_HANDLER_(name##_pal_handler, PAL, name)
+    C64_C128_BUS_HANDLER_WRITE(name, name##_write_handler)
 
-#define C64_C128_BUS_HANDLER_(handler, timing, name)                            \
+#define C64_C128_BUS_HANDLER_WRITE(name, write_handler)                         \
+    C64_C128_BUS_HANDLER_(name##_ntsc_handler, NTSC, name, write_handler)       \
+    C64_C128_BUS_HANDLER_(name##_pal_handler, PAL, name, write_handler)
+
+#define C64_C128_BUS_HANDLER_(handler, timing, name, write_handler)             \
     C64_VIC_BUS_HANDLER_EX__(handler, timing##_CPU_VIC_DELAY(),                 \
                             name##_read_handler, name##_read_handler,           \
-                            timing##_WRITE_DELAY(), name##_write_handler,       \
+                            timing##_WRITE_DELAY(), write_handler,              \
                             C64_NO_DELAY(), timing)
 
 // This supports VIC-II reads from the cartridge (i.e. character and sprite data)
@@ -293,6 +334,7 @@ void handler(void)
         {                                                                       \
             if (read_handler(control, addr))                                    \
             {                                                                   \
+                C64_BUS_STATS(BUS_STATS_READ, timing##_PHI2_CPU_END);           \
                 /* Release bus when phi2 is going low */                        \
                 while (DWT->CYCCNT < timing##_PHI2_CPU_END);                    \
                 C64_DATA_INPUT();                                               \
@@ -303,6 +345,7 @@ void handler(void)
             early_write_handler;                                                \
             u32 data = C64_DATA_READ();                                         \
             write_handler(control, addr, data);                                 \
+            C64_BUS_STATS(BUS_STATS_WRITE, timing##_PHI2_VIC_START);            \
         }                                                                       \
         /* VIC-II has the bus */                                                \
         else                                                                    \
@@ -312,6 +355,7 @@ void handler(void)
             control = C64_CONTROL_READ();                                       \
             if (vic_read_handler(control, addr))                                \
             {                                                                   \
+                C64_BUS_STATS(BUS_STATS_VIC, timing##_PHI2_CPU_END);            \
                 /* Release bus when phi2 is going low */                        \
                 while (DWT->CYCCNT < timing##_PHI2_CPU_END);                    \
                 C64_DATA_INPUT();                                               \
@@ -333,6 +377,7 @@ void handler(void)
         control = C64_CONTROL_READ();                                           \
         if (vic_read_handler(control, addr))                                    \
         {                                                                       \
+            C64_BUS_STATS(BUS_STATS_VIC, timing##_PHI2_VIC_END);                \
             /* Release bus when phi2 is going high */                           \
             while (DWT->CYCCNT < timing##_PHI2_VIC_END);                        \
             C64_DATA_INPUT();                                                   \
@@ -67,12 +67,61 @@
                                      SDIO_STA_TXUNDERR | SDIO_STA_RXOVERR |     \
                                      SDIO_STA_STBITERR)
 
+// DMA2 stream 3 and 6, channel 4 are connected to the SDIO
+#define SDIO_DMA_RX     DMA2_Stream3
+#define SDIO_DMA_TX     DMA2_Stream6
+
+#define SDIO_DMA_CR     (DMA_SxCR_CHSEL_2|DMA_SxCR_MBURST_0|DMA_SxCR_PBURST_0| \
+                         DMA_SxCR_MSIZE_1|DMA_SxCR_PSIZE_1|DMA_SxCR_MINC|      \
+                         DMA_SxCR_PFCTRL)
+
+#define DMA_LIFCR_STREAM3_FLAGS (DMA_LIFCR_CTCIF3|DMA_LIFCR_CHTIF3|    \
+                                 DMA_LIFCR_CTEIF3|DMA_LIFCR_CDMEIF3|   \
+                                 DMA_LIFCR_CFEIF3)
+
+#define DMA_HIFCR_STREAM6_FLAGS (DMA_HIFCR_CTCIF6|DMA_HIFCR_CHTIF6|    \
+                                 DMA_HIFCR_CTEIF6|DMA_HIFCR_CDMEIF6|   \
+                                 DMA_HIFCR_CFEIF6)
+
+// SDIO clock settings (SDIOCLK is 48MHz)
+#define SDIO_CLKCR_CLOCK        (SDIO_CLKCR_CLKDIV|SDIO_CLKCR_BYPASS)
+#define SDIO_CLK_SAFE           2                   // 12MHz (SDIOCLK / [CLKDIV + 2])
+#define SDIO_CLK_DEFAULT_SPEED  0                   // 24MHz
+#define SDIO_CLK_HIGH_SPEED     SDIO_CLKCR_BYPASS   // 48MHz
+
 static u32 card_rca;
 static u8 card_type;
 static u8 card_info[36];    // CSD, CID, OCR
 
 static DSTATUS dstatus = STA_NOINIT;
 
+// Clock used when the C64 interface isn't active
+static u32 sdio_fast_clk = SDIO_CLK_SAFE;
+
+static u32 card_sectors;
+
+// Read-ahead cache
+static u8 *disk_cache_buf;
+static u32 disk_cache_size;     // In sectors
+static u32 disk_cache_count;    // Number of valid sectors
+static DWORD disk_cache_sector; // First sector in cache
+static u32 disk_cache_hits;
+static u32 disk_cache_misses;
+
+// Pending background read
+static struct
+{
+    BYTE *buf;
+    DWORD sector;
+    UINT count;
+    bool started;
+    bool ok;
+} disk_async;
+
+// DMA capable buffer used for writes from CCM RAM while the C64 interface is
+// active. Must be able to hold a single sector
+static u8 *sdio_bounce_buf;
+
 
 static void sdio_init(void)
 {
@@ -121,6 +170,10 @@ static void sdio_init(void)
     delay_us(200);  // Wait for 80 cycles at 400kHz
 
     SDIO->DTIMER = 24000000;
+
+    // Enable DMA2 for SDIO data transfers
+    RCC->AHB1ENR |= RCC_AHB1ENR_DMA2EN;
+    __DSB();
 }
 
 static void sdio_deinit(void)
@@ -154,6 +207,91 @@ static void sdio_deinit(void)
     MODIFY_REG(GPIOD->PUPDR, GPIO_PUPDR_PUPD2, 0);
 }
 
+static void sdio_set_bounce_buffer(u8 *buf)
+{
+    sdio_bounce_buf = buf;
+}
+
+static bool sdio_dma_capable(const void *buf)
+{
+    // The DMA controller has no access to CCM RAM. Memory bursts of 4 words
+    // must not cross a 1k boundary which is ensured by 16 byte alignment
+    u32 addr = (u32)buf;
+    return !(addr & 15) && (addr < CCMDATARAM_BASE || addr > CCMDATARAM_END);
+}
+
+static void sdio_dma_start(DMA_Stream_TypeDef *stream, u32 dir, const void *buf)
+{
+    stream->CR = 0;
+    while (stream->CR & DMA_SxCR_EN);
+
+    if (stream == SDIO_DMA_RX)
+    {
+        DMA2->LIFCR = DMA_LIFCR_STREAM3_FLAGS;
+    }
+    else
+    {
+        DMA2->HIFCR = DMA_HIFCR_STREAM6_FLAGS;
+    }
+
+    // Transfer length is controlled by the SDIO (peripheral flow control)
+    stream->PAR = (u32)&SDIO->FIFO;
+    stream->M0AR = (u32)buf;
+    stream->FCR = DMA_SxFCR_DMDIS|DMA_SxFCR_FTH;
+    stream->CR = SDIO_DMA_CR|dir;
+    stream->CR |= DMA_SxCR_EN;
+}
+
+static u32 sdio_dma_wait(DMA_Stream_TypeDef *stream)
+{
+    u32 sta;
+    do
+    {
+        sta = SDIO->STA;
+    }
+    while (!(sta & (SDIO_STA_DATAEND|SDIO_STA_TRX_ERROR_FLAGS)));
+
+    if (sta & SDIO_STA_TRX_ERROR_FLAGS)
+    {
+        stream->CR &= ~DMA_SxCR_EN;
+    }
+
+    // Wait for the DMA to empty its FIFO
+    while (stream->CR & DMA_SxCR_EN);
+    SDIO->DCTRL = 0;
+
+    return sta;
+}
+
+static void sdio_dma_stop(DMA_Stream_TypeDef *stream)
+{
+    SDIO->DCTRL = 0;
+    stream->CR &= ~DMA_SxCR_EN;
+    while (stream->CR & DMA_SxCR_EN);
+}
+
+static void disk_cache_invalidate(void)
+{
+    disk_cache_count = 0;
+}
+
+// Reads smaller than the buffer will read ahead to fill it. A NULL buffer
+// disables the read-ahead cache
+static void disk_set_read_ahead(u8 *buf, u32 size)
+{
+    if (disk_cache_buf)
+    {
+        dbg("Read-ahead cache hits: %u misses: %u", disk_cache_hits,
+            disk_cache_misses);
+    }
+
+    disk_cache_buf = buf;
+    disk_cache_size = buf ? size / 512 : 0;
+    disk_cache_hits = 0;
+    disk_cache_misses = 0;
+    disk_cache_invalidate();
+}
+
 static void byte_swap(u8 *dest, u32 src)
 {
     u32 *dest32 = (u32 *)dest;
@@ -239,6 +377,95 @@ static bool sdio_cmd_send(u8 idx, u32 arg, int resp_type, u32 *buf)
     return true;
 }
 
+static u32 sdio_read_fifo(u32 *buf32, u32 bytes)
+{
+    u32 *buf32_end = buf32 + bytes / 4;
+    u32 sta;
+    do
+    {
+        sta = SDIO->STA;
+        if (sta & SDIO_STA_RXDAVL)
+        {
+            // Discard data that doesn't fit in the buffer
+            u32 data = SDIO->FIFO;
+            if (buf32 < buf32_end)
+            {
+                *buf32++ = data;
+            }
+        }
+    }
+    while (!(sta & (SDIO_STA_DATAEND|SDIO_STA_TRX_ERROR_FLAGS)));
+
+    // Read data still in FIFO
+    while (SDIO->STA & SDIO_STA_RXDAVL && buf32 < buf32_end)
+    {
+        *buf32++ = SDIO->FIFO;
+    }
+
+    return sta;
+}
+
+static void sdio_set_clock(u32 clk)
+{
+    u32 clkcr = SDIO->CLKCR;
+    if ((clkcr & SDIO_CLKCR_CLOCK) != clk)
+    {
+        SDIO->CLKCR = (clkcr & ~SDIO_CLKCR_CLOCK) | clk;
+        // After a data write, data cannot be written to this register for
+        // three SDIOCLK clock periods plus two PCLK2 clock periods.
+        delay_us(1);
+    }
+}
+
+static void sdio_update_clock(void)
+{
+    // We will get timeouts at higher frequencies when the C64 bus interface
+    // is active
+    sdio_set_clock(c64_interface_active() ? SDIO_CLK_SAFE : sdio_fast_clk);
+}
+
+static void sdio_lower_fast_clock(void)
+{
+    if (c64_interface_active() || sdio_fast_clk == SDIO_CLK_SAFE)
+    {
+        return;
+    }
+
+    sdio_fast_clk = sdio_fast_clk == SDIO_CLK_HIGH_SPEED ?
+                    SDIO_CLK_DEFAULT_SPEED : SDIO_CLK_SAFE;
+    wrn("Lowering SDIO clock (%x)", sdio_fast_clk);
+
+    sdio_update_clock();
+}
+
+static bool sdio_switch_high_speed(void)
+{
+    u32 status[16]; // 512 bit switch function status
+
+    SDIO->ICR = SDIO_ICR_DATA_FLAGS;
+    SDIO->DLEN = sizeof(status);
+    SDIO->DCTRL = SDIO_DCTRL_DBLOCKSIZE_1|SDIO_DCTRL_DBLOCKSIZE_2|
+                  SDIO_DCTRL_DTDIR|SDIO_DCTRL_DTEN;
+    __DSB();
+
+    // Set access mode (function group 1) to high-speed
+    u32 resp;
+    if (!sdio_cmd_send(6, 0x80fffff1, RESP_SHORT, &resp) || (resp & 0xc0580000))
+    {
+        return false;
+    }
+
+    u32 sta = sdio_read_fifo(status, sizeof(status));
+    if (sta & SDIO_STA_TRX_ERROR_FLAGS)
+    {
+        wrn("%s SDIO_STA: %08x", __func__, sta);
+        return false;
+    }
+
+    // Bits 379:376 contain the selected function for group 1
+    return (((u8 *)status)[16] & 0x0f) == 1;
+}
+
 static bool sdio_check_ready(u32 tout_ms)
 {
     u32 resp;
@@ -404,11 +631,40 @@ DSTATUS disk_initialize(BYTE pdrv)
         clkcr = (clkcr & ~SDIO_CLKCR_WIDBUS) | SDIO_CLKCR_WIDBUS_0;
     }
 
-    // Increase clock frequency to 12MHz (SDIOCLK / [CLKDIV + 2])
-    // We will get timeouts at higher frequencies when the C64 bus interface is active
-    SDIO->CLKCR = (clkcr & ~SDIO_CLKCR_CLKDIV) | 2;
+    // Increase clock frequency to 12MHz
+    SDIO->CLKCR = (clkcr & ~SDIO_CLKCR_CLOCK) | SDIO_CLK_SAFE;
     delay_us(7);    // Wait for 80 cycles at 12MHz
 
+    // Use 24MHz or 48MHz (high-speed mode) when the C64 interface is inactive
+    sdio_fast_clk = SDIO_CLK_SAFE;
+    if (card_type & CT_SD2)
+    {
+        sdio_fast_clk = SDIO_CLK_DEFAULT_SPEED;
+        if (sdio_switch_high_speed())
+        {
+            dbg("card supports high-speed");
+            sdio_fast_clk = SDIO_CLK_HIGH_SPEED;
+        }
+    }
+
+    // Get card capacity from CSD
+    if ((card_info[0] >> 6) == 1)   // CSD version 2.0
+    {
+        u32 c_size = ((card_info[7] & 0x3f) << 16) | (card_info[8] << 8) |
+                     card_info[9];
+        card_sectors = (c_size + 1) << 10;
+    }
+    else
+    {
+        u32 read_bl_len = card_info[5] & 0x0f;
+        u32 c_size = ((card_info[6] & 0x03) << 10) | (card_info[7] << 2) |
+                     (card_info[8] >> 6);
+        u32 c_size_mult = ((card_info[9] & 0x03) << 1) | (card_info[10] >> 7);
+        card_sectors = (c_size + 1) << (c_size_mult + 2 + read_bl_len - 9);
+    }
+    dbg("card sectors: %u", card_sectors);
+
+    disk_cache_invalidate();
     dstatus &= ~STA_NOINIT;
     return RES_OK;
 
@@ -423,12 +679,20 @@ DSTATUS disk_status(BYTE pdrv)
     return dstatus;
 }
 
-static UINT disk_read_imp(BYTE* buf, DWORD sector, UINT count)
+static bool disk_read_imp_start(BYTE* buf, DWORD sector, UINT count)
 {
+    bool dma = sdio_dma_capable(buf);
+    u32 dctrl = SDIO_DCTRL_DBLOCKSIZE_0|SDIO_DCTRL_DBLOCKSIZE_3|
+                SDIO_DCTRL_DTDIR|SDIO_DCTRL_DTEN;
+    if (dma)
+    {
+        sdio_dma_start(SDIO_DMA_RX, 0, buf);
+        dctrl |= SDIO_DCTRL_DMAEN;
+    }
+
     SDIO->ICR = SDIO_ICR_DATA_FLAGS;
     SDIO->DLEN = 512 * count;
-    SDIO->DCTRL = SDIO_DCTRL_DBLOCKSIZE_0|SDIO_DCTRL_DBLOCKSIZE_3|
-                  SDIO_DCTRL_DTDIR|SDIO_DCTRL_DTEN;
+    SDIO->DCTRL = dctrl;
     __DSB();
 
     // Send command to start data transfer
@@ -436,29 +700,27 @@ static UINT disk_read_imp(BYTE* buf, DWORD sector, UINT count)
     u32 resp;
     if (!sdio_cmd_send(cmd, sector, RESP_SHORT, &resp) || (resp & 0xc0580000))
     {
+        if (dma)
+        {
+            sdio_dma_stop(SDIO_DMA_RX);
+        }
         return false;
     }
 
-    u32 *buf32 = (u32 *)buf;
+    return true;
+}
 
+static UINT disk_read_imp_end(BYTE* buf, UINT count)
+{
     u32 sta;
-    do
+    if (sdio_dma_capable(buf))
     {
-        sta = SDIO->STA;
-        if (sta & SDIO_STA_RXDAVL)
-        {
-            *buf32++ = SDIO->FIFO;
-        }
+        sta = sdio_dma_wait(SDIO_DMA_RX);
     }
-    while (!(sta & (SDIO_STA_DATAEND|SDIO_STA_TRX_ERROR_FLAGS)));
-
-    u32 *buf32_end = (u32 *)(buf + 512 * count);
-
-    // Read data still in FIFO
-	while (SDIO->STA & SDIO_STA_RXDAVL && buf32 < buf32_end)
+    else
     {
-        *buf32++ = SDIO->FIFO;
-	}
+        sta = sdio_read_fifo((u32 *)buf, 512 * count);
+    }
 
     if (sta & SDIO_STA_TRX_ERROR_FLAGS)
     {
@@ -466,14 +728,61 @@ static UINT disk_read_imp(BYTE* buf, DWORD sector, UINT count)
     }
 
     // Stop multi block transfer
-    if (cmd == 18)
+    if (count > 1)
     {
+        u32 resp;
         sdio_cmd_send(12, 0, RESP_SHORT, &resp);
     }
 
     return !(sta & SDIO_STA_TRX_ERROR_FLAGS);
 }
 
+static UINT disk_read_imp(BYTE* buf, DWORD sector, UINT count)
+{
+    return disk_read_imp_start(buf, sector, count) &&
+           disk_read_imp_end(buf, count);
+}
+
+static DRESULT disk_read_card(BYTE* buf, DWORD sector, UINT count)
+{
+    if (!(card_type & CT_BLOCK))
+    {
+        sector *= 512;
+    }
+
+    sdio_update_clock();
+
+    UINT result = false;
+    for (u32 retry=0; retry<10 && !result; retry++)
+    {
+        if (!sdio_check_ready(500))
+        {
+            return RES_ERROR;
+        }
+
+        result = disk_read_imp(buf, sector, count);
+        if (!result && retry)
+        {
+            sdio_lower_fast_clock();
+        }
+    }
+
+    return result ? RES_OK : RES_ERROR;
+}
+
+static bool disk_read_cached(BYTE* buf, DWORD sector, UINT count)
+{
+    if (sector >= disk_cache_sector &&
+        (sector + count) <= (disk_cache_sector + disk_cache_count))
+    {
+        memcpy(buf, disk_cache_buf + (sector - disk_cache_sector) * 512,
+               count * 512);
+        return true;
+    }
+
+    return false;
+}
+
 DRESULT disk_read(BYTE pdrv, BYTE* buf, DWORD sector, UINT count)
 {
     led_toggle();
@@ -488,23 +797,102 @@ DRESULT disk_read(BYTE pdrv, BYTE* buf, DWORD sector, UINT count)
         return RES_NOTRDY;
     }
 
+    if (count >= disk_cache_size)
+    {
+        return disk_read_card(buf, sector, count);
+    }
+
+    if (disk_read_cached(buf, sector, count))
+    {
+        disk_cache_hits++;
+        return RES_OK;
+    }
+
+    disk_cache_misses++;
+    disk_cache_invalidate();
+
+    // Don't read beyond the end of the card
+    u32 read_ahead = disk_cache_size;
+    if (card_sectors > sector && (card_sectors - sector) < read_ahead)
+    {
+        read_ahead = card_sectors - sector;
+    }
+
+    if (read_ahead < count)
+    {
+        read_ahead = count;
+    }
+
+    DRESULT res = disk_read_card(disk_cache_buf, sector, read_ahead);
+    if (res == RES_OK)
+    {
+        disk_cache_sector = sector;
+        disk_cache_count = read_ahead;
+        disk_read_cached(buf, sector, count);
+    }
+
+    return res;
+}
+
+// Start a DMA read that completes in the background while the CPU is busy
+// with something else, e.g. programming the flash. Must be followed by
+// disk_read_finish() before any other disk access
+static void disk_read_start(BYTE* buf, DWORD sector, UINT count)
+{
+    disk_async.buf = buf;
+    disk_async.sector = sector;
+    disk_async.count = count;
+    disk_async.started = false;
+    disk_async.ok = false;
+
+    if ((dstatus & STA_NOINIT) || count < 1 || count > 128 ||
+        !sdio_dma_capable(buf))
+    {
+        return;
+    }
+
+    led_toggle();
     if (!(card_type & CT_BLOCK))
     {
         sector *= 512;
     }
 
-    UINT result = false;
-    for (u32 retry=0; retry<10 && !result; retry++)
+    sdio_update_clock();
+    if (sdio_check_ready(500))
     {
-        if (!sdio_check_ready(500))
-        {
-            return RES_ERROR;
-        }
+        disk_async.started = disk_read_imp_start(buf, sector, count);
+    }
+}
 
-        result = disk_read_imp(buf, sector, count);
+// Complete the background read if all data has been received. This stops
+// the multi block transfer as soon as possible. Returns true when done
+static bool disk_read_poll(void)
+{
+    if (disk_async.started &&
+        (SDIO->STA & (SDIO_STA_DATAEND|SDIO_STA_TRX_ERROR_FLAGS)))
+    {
+        disk_async.started = false;
+        disk_async.ok = disk_read_imp_end(disk_async.buf, disk_async.count);
     }
 
-    return result ? RES_OK : RES_ERROR;
+    return !disk_async.started;
+}
+
+static DRESULT disk_read_finish(void)
+{
+    if (disk_async.started)
+    {
+        disk_async.started = false;
+        disk_async.ok = disk_read_imp_end(disk_async.buf, disk_async.count);
+    }
+
+    if (disk_async.ok)
+    {
+        return RES_OK;
+    }
+
+    // Retry (or read) synchronously
+    return disk_read(0, disk_async.buf, disk_async.sector, disk_async.count);
 }
 
 static UINT disk_write_imp(const BYTE* buf, DWORD sector, UINT count)
@@ -540,31 +928,43 @@ static UINT disk_write_imp(const BYTE* buf, DWORD sector, UINT count)
         return false;
     }
 
-    // Note: Will not work while the C64 interrupt handler is enabled
-    __disable_irq();
-    SDIO->DCTRL = SDIO_DCTRL_DBLOCKSIZE_0|SDIO_DCTRL_DBLOCKSIZE_3|
-                  SDIO_DCTRL_DTEN;
-
-    // Send the first 8 words to avoid TX FIFO underrun
-    SDIO->FIFO = first_word;
-    for (u32 i=0; i<7; i++)
+    u32 sta;
+    if (sdio_dma_capable(buf))
     {
-        SDIO->FIFO = *buf32++;
-    }
+        // The DMA will keep the TX FIFO filled, no need to disable interrupts
+        sdio_dma_start(SDIO_DMA_TX, DMA_SxCR_DIR_0, buf);
+        SDIO->DCTRL = SDIO_DCTRL_DBLOCKSIZE_0|SDIO_DCTRL_DBLOCKSIZE_3|
+                      SDIO_DCTRL_DMAEN|SDIO_DCTRL_DTEN;
 
-    const u32 *buf32_end = (u32 *)(buf + 512 * count);
-
-    u32 sta;
-    do
+        sta = sdio_dma_wait(SDIO_DMA_TX);
+    }
+    else
     {
-        sta = SDIO->STA;
-        if (!(sta & SDIO_STA_TXFIFOF) && buf32 < buf32_end)
+        // Note: Will not work while the C64 interrupt handler is enabled
+        __disable_irq();
+        SDIO->DCTRL = SDIO_DCTRL_DBLOCKSIZE_0|SDIO_DCTRL_DBLOCKSIZE_3|
+                      SDIO_DCTRL_DTEN;
+
+        // Send the first 8 words to avoid TX FIFO underrun
+        SDIO->FIFO = first_word;
+        for (u32 i=0; i<7; i++)
         {
             SDIO->FIFO = *buf32++;
         }
+
+        const u32 *buf32_end = (u32 *)(buf + 512 * count);
+
+        do
+        {
+            sta = SDIO->STA;
+            if (!(sta & SDIO_STA_TXFIFOF) && buf32 < buf32_end)
+            {
+                SDIO->FIFO = *buf32++;
+            }
+        }
+        while (!(sta & (SDIO_STA_DATAEND|SDIO_STA_TRX_ERROR_FLAGS)));
+        __enable_irq();
     }
-    while (!(sta & (SDIO_STA_DATAEND|SDIO_STA_TRX_ERROR_FLAGS)));
-    __enable_irq();
 
     if (sta & SDIO_STA_TRX_ERROR_FLAGS)
     {
@@ -596,17 +996,38 @@ DRESULT disk_write(BYTE pdrv, const BYTE* buf, DWORD sector, UINT count)
 
     // Note: No check of Write Protect Pin
 
-    if (!(card_type & CT_BLOCK))
+    if (disk_cache_count && sector < (disk_cache_sector + disk_cache_count) &&
+        (sector + count) > disk_cache_sector)
     {
-        sector *= 512;
+        disk_cache_invalidate();
+    }
+
+    if (!sdio_dma_capable(buf) && c64_interface_active())
+    {
+        if (!sdio_bounce_buf)
+        {
+            err("%s C64 interface active", __func__);
+            return RES_ERROR;
+        }
+
+        // Copy to the DMA capable buffer one sector at a time
+        DRESULT res = RES_OK;
+        for (UINT i=0; i<count && res == RES_OK; i++)
+        {
+            memcpy(sdio_bounce_buf, buf + i * 512, 512);
+            res = disk_write(pdrv, sdio_bounce_buf, sector + i, 1);
+        }
+
+        return res;
     }
 
-    if (c64_interface_active())
+    if (!(card_type & CT_BLOCK))
     {
-        err("%s C64 interface active", __func__);
-        return RES_ERROR;
+        sector *= 512;
     }
 
+    sdio_update_clock();
+
     UINT result = false;
     for (u32 retry=0; retry<3 && !result; retry++)
     {
@@ -616,6 +1037,10 @@ DRESULT disk_write(BYTE pdrv, const BYTE* buf, DWORD sector, UINT count)
         }
 
         result = disk_write_imp(buf, sector, count);
+        if (!result)
+        {
+            sdio_lower_fast_clock();
+        }
     }
 
     return result ? RES_OK : RES_ERROR;
@@ -20,6 +20,17 @@
 #define FLASH_KEYR_KEY1     0x45670123
 #define FLASH_KEYR_KEY2     0xCDEF89AB
 
+// Throughput counters
+typedef struct
+{
+    u32 erased;     // Sectors
+    u32 programmed; // Bytes written
+    u32 skipped;    // Bytes already matching the flash
+    u32 time_us;    // Time spent erasing and programming
+} FLASH_STATS;
+
+static FLASH_STATS flash_stats;
+
 static void flash_unlock(void)
 {
     FLASH->KEYR = FLASH_KEYR_KEY1;
@@ -58,27 +69,42 @@ static void flash_sector_erase(u8 sector)
 
     // Wait for the operation to complete
     while (FLASH->SR & FLASH_SR_BSY);
+    flash_stats.erased++;
 }
 
 static void flash_program(void *dest, void *src, size_t bytes)
 {
     volatile u32 *dest_ptr = (u32 *)dest;
     u32 *src_ptr = (u32 *)src;
+    u32 programmed = 0;
 
     // Wait if a flash memory operation is in progress
     while (FLASH->SR & FLASH_SR_BSY);
 
-    // Activate flash programming
-    MODIFY_REG(FLASH->CR, FLASH_CR_SER, FLASH_CR_PG);
+    // Activate flash programming with x32 parallelism. This is the widest
+    // possible without an external Vpp (x64 requires 8-9 V)
+    MODIFY_REG(FLASH->CR, FLASH_CR_PSIZE|FLASH_CR_SER,
+               FLASH_CR_PSIZE_1|FLASH_CR_PG);
 
-	for (size_t i=0; i<bytes; i+=4)
+    u32 *end_ptr = src_ptr + bytes/4;
+    while (src_ptr < end_ptr)
     {
-		*dest_ptr++ = *src_ptr++;
-		while (FLASH->SR & FLASH_SR_BSY);
-	}
+        // Skip words that are already programmed (or left erased)
+        u32 data = *src_ptr++;
+        if (*dest_ptr != data)
+        {
+            *dest_ptr = data;
+            programmed++;
+            while (FLASH->SR & FLASH_SR_BSY);
+        }
+        dest_ptr++;
+    }
 
     // Deactivate flash programming
     FLASH->CR &= ~FLASH_CR_PG;
+
+    flash_stats.programmed += programmed * 4;
+    flash_stats.skipped += bytes - programmed * 4;
 }
 
 static void flash_program_byte(u8 *dest, u8 byte)
@@ -100,9 +126,17 @@ static void flash_program_byte(u8 *dest, u8 byte)
 
 static void flash_sector_program(s8 sector, void *dest, void *src, size_t bytes)
 {
-    // Prevent anything executing from flash
-    __disable_irq();
-
+    // All code and the vector table execute from SRAM, so only interrupts
+    // that may access the flash or restart the firmware are held off.
+    // USB stays alive during the operation
+    bool c64_irq = NVIC_GetEnableIRQ(TIM1_CC_IRQn);
+    bool button_irq = NVIC_GetEnableIRQ(EXTI4_IRQn);
+    NVIC_DisableIRQ(TIM1_CC_IRQn);
+    NVIC_DisableIRQ(EXTI4_IRQn);
+    __DSB();
+    __ISB();
+
+    u32 start = DWT->CYCCNT;
     flash_unlock();
     if (sector >= 0 && sector <= 11)
     {
@@ -110,6 +144,28 @@ static void flash_sector_program(s8 sector, void *dest, void *src, size_t bytes)
     }
     flash_program(dest, src, bytes);
     flash_lock();
+    flash_stats.time_us += (DWT->CYCCNT - start) / 168;
+
+    if (button_irq)
+    {
+        NVIC_EnableIRQ(EXTI4_IRQn);
+    }
+    if (c64_irq)
+    {
+        NVIC_EnableIRQ(TIM1_CC_IRQn);
+    }
+}
 
-    __enable_irq();
+static void flash_stats_reset(void)
+{
+    memset(&flash_stats, 0, sizeof(flash_stats));
+}
+
+static void flash_stats_print(void)
+{
+    dbg("Flash: %u sectors erased, %u KB programmed (%u KB/s), "
+        "%u KB skipped in %u ms", flash_stats.erased,
+        flash_stats.programmed / 1024,
+        flash_stats.programmed / 1024 * 1000 / (flash_stats.time_us / 1000 + 1),
+        flash_stats.skipped / 1024, flash_stats.time_us / 1000);
 }
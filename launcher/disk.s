@@ -101,11 +101,17 @@ KFF_DATA                = $de00
 KFF_COMMAND             = $de01
 KFF_CONTROL             = $de02
 KFF_RAM_TST             = $de03
+KFF_READ_LPTR           = $de04
+KFF_READ_HPTR           = $de05
 KFF_WRITE_LPTR          = $de06
 KFF_WRITE_HPTR          = $de07
 KFF_RAM                 = $de08
 
 KFF_RAM_SIZE            = $00f8
+KFF_BASIN_BUF           = $3f00         ; Align with disk_drive.h
+KFF_BSOUT_BUF           = $3e00         ; Align with disk_drive.h
+KFF_BSOUT_SIZE          = $ff
+KFF_LOAD_CHUNK_SIZE     = $2000         ; Align with disk_drive.h
 KFF_KILL                = $00
 KFF_ENABLE              = $01
 
@@ -128,6 +134,7 @@ REPLY_SEND_BYTE         = $96
 REPLY_LISTEN            = $97
 REPLY_UNLISTEN          = $98
 REPLY_RECEIVE_BYTE      = $99
+REPLY_LOAD_NEXT         = $9a
 
 ; =============================================================================
 VECTOR_PAGE     = IOPEN & $ff00
@@ -226,6 +233,12 @@ install_disk_vectors:
 ; =============================================================================
 disk_api:
 .org KFF_RAM
+basin_count:                            ; Bytes left in KFF_BASIN_BUF
+        .byte $00                       ; Align with disk_drive.h
+basin_ptr:
+        .byte $00
+bsout_count:                            ; Bytes in KFF_BSOUT_BUF
+        .byte $00
 tmp1:
         .byte $ff
 tmp2:
@@ -704,12 +717,21 @@ kff_basin:
         lda STATUS
         bne @status_not_ok
 
+        lda basin_count
+        bne @read_buffer                ; Data already in buffer
+
         lda #REPLY_SEND_BYTE            ; Send reply
         jsr kff_send_reply
         bne @check_read_error           ; Check command
 
-@read_byte:
-        lda KFF_DATA                    ; Get data
+@read_buffer:
+        lda basin_ptr                   ; Get data from buffer
+        sta KFF_READ_LPTR
+        lda #>KFF_BASIN_BUF
+        sta KFF_READ_HPTR
+        inc basin_ptr
+        dec basin_count
+        lda KFF_DATA
 @read_done:
         clc
         jmp disable_kff_rom
@@ -720,7 +742,7 @@ kff_basin:
 
         lda #STATUS_END_OF_FILE         ; Set status to end of file
         sta STATUS
-        bne @read_byte
+        bne @read_buffer
 
 @read_error:
         lda #STATUS_READ_ERROR          ; Set device status to read error occurred
@@ -738,7 +760,21 @@ kff_basin:
 kff_bsout:
         pla
         sta tmp1
-        sta KFF_DATA                    ; Send data
+
+        lda bsout_count                 ; Add data to buffer
+        sta KFF_WRITE_LPTR
+        lda #>KFF_BSOUT_BUF
+        sta KFF_WRITE_HPTR
+        lda tmp1
+        sta KFF_DATA
+        lda #$00                        ; Restore write pointer
+        sta KFF_WRITE_LPTR
+        sta KFF_WRITE_HPTR
+
+        inc bsout_count                 ; Buffer is sent on UNLISTEN, CLOSE
+        lda bsout_count                 ; or when full
+        cmp #KFF_BSOUT_SIZE
+        bne @write_ok
 
         lda #REPLY_RECEIVE_BYTE         ; Send reply
         jsr kff_send_reply
@@ -843,6 +879,10 @@ kff_load:
 
 @load_start:
         ldy #$00
+        lda tmp2                        ; More chunks will follow if this
+        eor #>KFF_LOAD_CHUNK_SIZE       ; one is full
+        ora tmp1
+        pha
         ldx tmp2
         beq @load_rest
         bne @new_page
@@ -893,6 +933,18 @@ kff_load:
         dec tmp1
         bne @load_bytes
 @load_end:
+        pla
+        bne @load_done                  ; Last chunk
+
+        lda #REPLY_LOAD_NEXT            ; Get next chunk
+        jsr kff_send_reply
+        lda KFF_DATA                    ; Get chunk size
+        sta tmp1
+        lda KFF_DATA
+        sta tmp2
+        jmp @load_start
+
+@load_done:
         sty tmp1
         jsr install_disk_vectors        ; Reinstall vectors if changed
 
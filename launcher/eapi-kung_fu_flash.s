@@ -26,6 +26,7 @@
 CMD_EAPI_INIT           = $01
 CMD_WRITE_FLASH         = $02
 CMD_ERASE_SECTOR        = $03
+CMD_WRITE_FLASH_BLOCK   = $04
 
 REPLY_WRITE_WAIT        = $01
 REPLY_WRITE_ERROR       = $02
@@ -40,6 +41,9 @@ EAPI_ERR_ROMH_PROTECTED = 5
 ; There's a pointer to our code base
 EAPI_ZP_INIT_CODE_BASE   = $4b
 
+; Source pointer for EAPIWriteFlashBlock (unused by BASIC and KERNAL)
+EAPI_ZP_BLOCK_SRC        = $fb
+
 ; hardware dependend values
 KFF_NUM_BANKS      = 64
 KFF_MFR_ID         = $ff
@@ -127,6 +131,7 @@ jmpTable:
         jmp EAPIWriteFlashInc - initCodeBase
         jmp EAPISetSlot - initCodeBase
         jmp EAPIGetSlot - initCodeBase
+        jmp EAPIWriteFlashBlock - initCodeBase
 jmpTableEnd:
 
 ; =============================================================================
@@ -137,14 +142,12 @@ jmpTableEnd:
 ;
 ; =============================================================================
 kff_send_command:
-        lda #'k'
-        jsr ef3usb_send_byte
-        lda #'f'
-        jsr ef3usb_send_byte
-        lda #'f'
-        jsr ef3usb_send_byte
-        lda #':'
+        ldy #3
+:
+        lda kffCommand, y
         jsr ef3usb_send_byte
+        dey
+        bpl :-
         txa
         jsr ef3usb_send_byte
         lda EAPI_WRITE_ADDR_LO
@@ -156,6 +159,9 @@ kff_send_command:
         ; get reply
         jmp ef3usb_receive_byte
 
+kffCommand:
+        .byte ":ffk"                    ; sent in reverse order
+
 ; =============================================================================
 ;
 ; Internal function
@@ -723,3 +729,72 @@ rwInc_return:
 EAPISetSlot:
 EAPIGetSlot:
         rts
+
+; =============================================================================
+;
+; EAPIWriteFlashBlock: Kung Fu Flash extension: To be called with
+; JSR jmpTable + 30 = $df9e
+;
+; This jump table entry is not part of the EAPI standard. Only use it if the
+; driver name (at <load_address> + 4) starts with "KungFuFlash".
+;
+; Write up to 256 bytes to the given address. The address must be as seen in
+; Ultimax mode (see EAPIWriteFlash) and the block must not cross an 8 KiB bank
+; boundary. This is much faster than calling EAPIWriteFlash for each byte.
+;
+; This function uses SEI, it restores all flags except C before it returns.
+; Do not call it with D-flag set. $01 must enable both ROM areas.
+; It can only be used after having called EAPIInit.
+;
+; parameters:
+;       A   number of bytes (0 = 256)
+;       XY  address (X = low), $8xxx/$9xxx or $Exxx/$Fxxx
+;       $fb/$fc pointer to the data (EAPI_ZP_BLOCK_SRC)
+;
+; return:
+;       C   set: Error
+;           clear: Okay
+; changes:
+;       Z,N <- number of bytes
+;
+; =============================================================================
+EAPIWriteFlashBlock:
+        sta EAPI_WRITE_VAL      ; used for length here
+        stx EAPI_WRITE_ADDR_LO
+        sty EAPI_WRITE_ADDR_HI
+        php
+        sei
+
+        lda EAPI_SHADOW_BANK
+        sta EASYFLASH_IO_BANK
+
+        ldx #CMD_WRITE_FLASH_BLOCK
+        jsr kff_send_command
+        bne blockError
+
+        ; send the data
+        ldy #0
+blockSend:
+        lda (EAPI_ZP_BLOCK_SRC), y
+        jsr ef3usb_send_byte
+        iny
+        cpy EAPI_WRITE_VAL
+        bne blockSend
+
+        ; get reply, the C64 interface is not disabled for block writes
+        jsr ef3usb_receive_byte
+        bne blockError
+
+        plp
+        clc
+        bcc blockRet
+blockError:
+        plp
+        sec ; error
+blockRet:
+        ldy EAPI_WRITE_ADDR_HI
+        ldx EAPI_WRITE_ADDR_LO
+        lda EAPI_WRITE_VAL
+        rts
+
+.assert * <= EAPICodeBase + $300, error, "EAPI driver too large"